@@ -68,9 +68,16 @@ int main(int argc, char *argv[]) {
     CLI11_PARSE(args, argc, argv);
 
     core::Dict refs, runs;
-    refs.load_file(ref_file);
+    if (!refs.load_file(ref_file)) {
+        fprintf(stderr, "failed to load \"%s\".\n", ref_file.data());
+        return -1;
+    }
     printf("loaded \"%s\".\n", ref_file.data());
-    runs.load_file(runs_file);
+
+    if (!runs.load_file(runs_file)) {
+        fprintf(stderr, "failed to load \"%s\".\n", runs_file.data());
+        return -1;
+    }
     printf("loaded \"%s\".\n", runs_file.data());
 
     std::fstream fp(dump_file);
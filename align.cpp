@@ -19,25 +19,44 @@ void print_set(const std::vector<int> &set) {
 int main(int argc, char *argv[]) {
     CLI::App args;
 
-    std::string ref_fasta, long_fasta;
+    std::string ref_fasta, long_fasta, image;
     args.add_option("-r,--ref", ref_fasta)->required();
     args.add_option("-l,--long", long_fasta)->required();
+    args.add_option("-x,--index", image, "cached index image");
 
     CLI11_PARSE(args, argc, argv);
 
     core::Dict ref, runs;
-    ref.load_file(ref_fasta);
+    if (!ref.load_file(ref_fasta)) {
+        fprintf(stderr, "failed to load \"%s\".\n", ref_fasta.data());
+        return -1;
+    }
     printf("read %zu string(s) from \"%s\".\n", ref.size(), ref_fasta.data());
-    runs.load_file(long_fasta);
+
+    if (!runs.load_file(long_fasta)) {
+        fprintf(stderr, "failed to load \"%s\".\n", long_fasta.data());
+        return -1;
+    }
     printf("read %zu string(s) from \"%s\".\n", runs.size(), long_fasta.data());
 
-    core::Index index;
+    core::TextFingerprint text;
     for (auto &e : ref) {
-        index.append(e.sequence);
-        index.append(core::CMAP['N']);
+        text.append_reference(e.sequence);
+    }
+
+    core::Index index;
+    if (!image.empty() && index.load(image, text))
+        printf("index loaded from \"%s\".\n", image.data());
+    else {
+        for (auto &e : ref) {
+            index.append_reference(e.sequence);
+        }
+        index.build();
+        printf("index built.\n");
+
+        if (!image.empty() && !index.save(image))
+            printf("warn: failed to save index to \"%s\".\n", image.data());
     }
-    index.build();
-    printf("index built.\n");
 
     while (true) {
         int idx, left, right;
@@ -0,0 +1,369 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CLI11.hpp"
+
+#include "core.hpp"
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+auto random_sequence(std::mt19937 &gen, int n) -> std::string {
+    std::string s;
+    s.resize(n);
+    for (auto &c : s) {
+        c = "ACGT"[gen() % 4];
+    }
+
+    return s;
+}
+
+// copy of s with roughly `rate` of its bases substituted, inserted or deleted.
+auto mutate(std::mt19937 &gen, const std::string &s, double rate) -> std::string {
+    std::uniform_real_distribution<double> U(0, 1);
+
+    std::string t;
+    t.reserve(s.size() * 2);
+    for (char c : s) {
+        auto x = U(gen);
+        if (x >= rate)
+            t.push_back(c);
+        else if (x < rate / 3)
+            t.push_back("ACGT"[gen() % 4]);
+        else if (x < rate * 2 / 3) {
+            t.push_back(c);
+            t.push_back("ACGT"[gen() % 4]);
+        }
+    }
+
+    return t;
+}
+
+template <typename TFn>
+auto measure(int repeat, const TFn &fn) -> double {
+    auto t_begin = Clock::now();
+    for (int i = 0; i < repeat; i++) {
+        fn();
+    }
+    auto t_end = Clock::now();
+
+    return std::chrono::duration<double, std::micro>(t_end - t_begin).count() / repeat;
+}
+
+auto same(int a, int b) -> bool {
+    return a == b;
+}
+
+auto same(const core::Alignment &a, const core::Alignment &b) -> bool {
+    return a.range1.begin == b.range1.begin && a.range1.end == b.range1.end &&
+        a.range2.begin == b.range2.begin && a.range2.end == b.range2.end &&
+        a.loss == b.loss;
+}
+
+auto same(const core::Decomposition &a, const core::Decomposition &b) -> bool {
+    if (a.area != b.area || a.slices.size() != b.slices.size())
+        return false;
+
+    for (int i = 0; i < a.slices.size(); i++) {
+        if (a.slices[i].begin != b.slices[i].begin || a.slices[i].end != b.slices[i].end)
+            return false;
+    }
+
+    return true;
+}
+
+// (s, t) with t a mutated copy of s.
+auto make_global_pair(std::mt19937 &gen, int n, double rate) {
+    auto s = random_sequence(gen, n);
+    auto t = mutate(gen, s, rate);
+    return std::make_pair(s, t);
+}
+
+// (s, t) with t a mutated copy of the middle of s, as in locate's windows.
+auto make_local_pair(std::mt19937 &gen, int n, double rate) {
+    auto s = random_sequence(gen, n * 2);
+    auto t = mutate(gen, s.substr(n / 2, n), rate);
+    return std::make_pair(s, t);
+}
+
+// (s, t) as from make_local_pair(), with n / 5 bases of s missing from
+// the middle of t, as in a run across a deletion.
+auto make_deletion_pair(std::mt19937 &gen, int n, double rate) {
+    auto s = random_sequence(gen, n * 2);
+    int k = n / 2;
+    auto t = mutate(gen, s.substr(n / 2, k) + s.substr(n / 2 + k + n / 5, n - k), rate);
+    return std::make_pair(s, t);
+}
+
+template <typename TPairFn, typename TFn, typename TRefFn>
+void compare(
+    const char *title,
+    const std::vector<int> &lengths, int repeat, double rate,
+    const TPairFn &make_pair, const TFn &fn, const TRefFn &ref_fn
+) {
+    std::mt19937 gen(19260817);
+
+    printf("%s:\n", title);
+    printf("%8s %14s %14s %8s\n", "length", "baseline(us)", "new(us)", "speedup");
+    for (int n : lengths) {
+        auto [s, t] = make_pair(gen, n, rate);
+        auto s1 = core::BioSeq(s), s2 = core::BioSeq(t);
+
+        if (!same(fn(s1, s2), ref_fn(s1, s2))) {
+            printf("mismatch at length %d.\n", n);
+            exit(-1);
+        }
+
+        int k = std::max(1, repeat * 300 / n);
+        auto t_ref = measure(k, [&] {
+            ref_fn(s1, s2);
+        });
+        auto t_new = measure(k, [&] {
+            fn(s1, s2);
+        });
+
+        printf("%8d %14.1lf %14.1lf %7.1lfx\n", n, t_ref, t_new, t_ref / t_new);
+    }
+}
+
+// mean fuzzy_locate() time over `repeat` mutated reads of each length,
+// half of them reverse complemented, from a random reference.
+void bench_fuzzy_locate(const std::vector<int> &lengths, int repeat, double rate, int reference_length) {
+    std::mt19937 gen(19260817);
+
+    auto reference = random_sequence(gen, reference_length);
+    core::Index index;
+    index.append(reference);
+    index.build();
+
+    printf("fuzzy_locate on a %d bp reference:\n", reference_length);
+    printf("%8s %14s %10s\n", "length", "per read(us)", "located");
+    for (int n : lengths) {
+        if (n > reference_length)
+            continue;
+
+        std::vector<std::string> reads;
+        std::vector<int> origins;
+        for (int k = 0; k < repeat; k++) {
+            int p = gen() % (reference_length - n + 1);
+            auto read = mutate(gen, reference.substr(p, n), rate);
+            if (k % 2)
+                read = core::watson_crick_complement(read);
+
+            reads.push_back(read);
+            origins.push_back(p + 1);
+        }
+
+        int n_located = 0;
+        auto t = measure(1, [&] {
+            for (int k = 0; k < repeat; k++) {
+                auto location = index.fuzzy_locate(reads[k]);
+                if (location.reversed == (k % 2) &&
+                    location.left <= origins[k] && origins[k] + n - 1 <= location.right)
+                    n_located++;
+            }
+        }) / repeat;
+
+        printf("%8d %14.1lf %6d/%-3d\n", n, t, n_located, repeat);
+    }
+}
+
+// n + 1 points (j, l1) shaped like the curve of the span DP: slope 1 up
+// to a breakpoint somewhere in the middle third, flat after it, noisy
+// throughout.
+auto make_span_curve(std::mt19937 &gen, int n) -> std::vector<core::Vec2d> {
+    std::normal_distribution<double> noise(0, 3);
+    int corner = n / 3 + gen() % (n / 3 + 1);
+
+    std::vector<core::Vec2d> vs;
+    double y = 0;
+    for (int j = 0; j <= n; j++) {
+        y += j < corner ? 1.0 : 0.1;
+        vs.push_back(core::Vec2d(j, std::max(0.0, y + noise(gen))));
+    }
+
+    return vs;
+}
+
+// french_stick_decompose() against the naive search it replaced, for
+// the K of 1 to 3 that the span DP asks for, on curves of each length and
+// on a few with fewer points than slices. false on the first difference.
+auto check_decompose(const std::vector<int> &lengths, int repeat) -> bool {
+    std::mt19937 gen(19260817);
+
+    auto check = [](const std::vector<core::Vec2d> &vs) {
+        for (int K = 1; K <= 3; K++) {
+            auto a = core::french_stick_decompose(vs, K);
+            auto b = core::french_stick_decompose_naive(vs, K);
+            if (!same(a, b)) {
+                printf("mismatch at %zu points, K = %d.\n", vs.size(), K);
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    for (int n = 0; n < 4; n++) {
+        if (!check(make_span_curve(gen, n)))
+            return false;
+    }
+
+    printf("french_stick_decompose, K = 3:\n");
+    printf("%8s %14s %14s %8s\n", "length", "baseline(us)", "new(us)", "speedup");
+    for (int n : lengths) {
+        auto vs = make_span_curve(gen, n);
+        if (!check(vs))
+            return false;
+
+        int k = std::max(1, repeat * 300 / n);
+        auto t_ref = measure(k, [&] {
+            core::french_stick_decompose_naive(vs, 3);
+        });
+        auto t_new = measure(k, [&] {
+            core::french_stick_decompose(vs, 3);
+        });
+
+        printf("%8d %14.1lf %14.1lf %7.1lfx\n", n, t_ref, t_new, t_ref / t_new);
+    }
+
+    return true;
+}
+
+// saves the index of one reference, then loads the image for a reference
+// of the same length that differs in a single base, which has to fail
+// and be rebuilt, and for the original one, which has to succeed.
+auto check_index_image(const std::string &path) -> bool {
+    std::mt19937 gen(19260817);
+    auto a = random_sequence(gen, 100000);
+    auto b = a;
+    b[b.size() / 2] = b[b.size() / 2] == 'A' ? 'C' : 'A';
+
+    auto fingerprint = [](std::string &s) {
+        core::TextFingerprint text;
+        text.append(core::BioSeq(s));
+        return text;
+    };
+
+    auto build = [](std::string &s) {
+        core::Index index;
+        index.append(core::BioSeq(s));
+        index.build();
+        return index;
+    };
+
+    // occurs in b only.
+    auto probe_string = b.substr(b.size() / 2 - 20, 41);
+    auto probe = core::BioSeq(probe_string);
+
+    if (!build(a).save(path)) {
+        printf("failed to save \"%s\".\n", path.data());
+        return false;
+    }
+
+    core::Index index;
+    if (index.load(path, fingerprint(b))) {
+        printf("image of one reference loaded for another.\n");
+        return false;
+    }
+
+    if (build(b).locate(probe).len != probe.size()) {
+        printf("rebuilt index misses the changed base.\n");
+        return false;
+    }
+
+    if (!index.load(path, fingerprint(a)) || index.locate(probe).len == probe.size()) {
+        printf("image not loaded for its own reference.\n");
+        return false;
+    }
+
+    printf("index image ok.\n");
+    return true;
+}
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> lengths = {300, 1000, 3000, 10000};
+    int repeat = 10;
+    double rate = 0.15;
+    int reference_length = 1000000;
+    std::string image_path = "bench.idx";
+
+    CLI::App args;
+    args.require_subcommand(1);
+    args.fallthrough();
+    args.add_option("-n", lengths, "sequence lengths");
+    args.add_option("-k", repeat, "repetitions at length 300, scaled down for longer inputs");
+    args.add_option("-e", rate, "error rate of the second sequence");
+
+    auto full_align = args.add_subcommand("full-align", "full_align: scalar DP vs. bit-parallel LCS");
+    full_align->callback([&] {
+        compare(
+            "full_align", lengths, repeat, rate, make_global_pair,
+            core::full_align_bitwise, core::full_align_scalar
+        );
+    });
+
+    auto local_align = args.add_subcommand("local-align", "local_align: scalar DP vs. dispatched SIMD kernel");
+    local_align->callback([&] {
+        compare(
+            "local_align", lengths, repeat, rate, make_local_pair,
+            [](const core::BioSeq &s1, const core::BioSeq &s2) {
+                return core::local_align(s1, s2);
+            },
+            core::local_align_scalar
+        );
+    });
+
+    auto fuzzy_locate = args.add_subcommand("fuzzy-locate", "per-read time of Index::fuzzy_locate");
+    fuzzy_locate->add_option("-g", reference_length, "length of the random reference");
+    fuzzy_locate->callback([&] {
+        bench_fuzzy_locate(lengths, repeat, rate, reference_length);
+    });
+
+    auto index_image = args.add_subcommand("index-image", "Index::load of an image against the text it was saved from");
+    index_image->add_option("-o", image_path, "where to write the image");
+    index_image->callback([&] {
+        if (!check_index_image(image_path))
+            exit(-1);
+    });
+
+    auto decompose = args.add_subcommand("decompose", "french_stick_decompose vs. the naive search it replaced");
+    decompose->callback([&] {
+        if (!check_decompose(lengths, repeat))
+            exit(-1);
+    });
+
+    auto banded_align = args.add_subcommand("banded-align", "local_align vs. banded_local_align around the true diagonal");
+    banded_align->callback([&] {
+        // both pairs put the start of t at offset n / 2 of s. t is about
+        // as long as the n of the pair.
+        auto banded = [rate](const core::BioSeq &s1, const core::BioSeq &s2) {
+            int n = s1.size() / 2;
+            return core::banded_local_align(s1, s2, n / 2, 16 + int(rate * n / 2));
+        };
+
+        auto unbanded = [](const core::BioSeq &s1, const core::BioSeq &s2) {
+            return core::local_align(s1, s2);
+        };
+
+        compare(
+            "banded_local_align", lengths, repeat, rate, make_local_pair,
+            banded, unbanded
+        );
+
+        // the second half of t lies n / 5 off the diagonal of the band.
+        compare(
+            "banded_local_align across a deletion", lengths, repeat, rate, make_deletion_pair,
+            banded, unbanded
+        );
+    });
+
+    CLI11_PARSE(args, argc, argv);
+
+    return 0;
+}
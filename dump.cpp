@@ -1,39 +1,110 @@
+#include <deque>
+#include <numeric>
+
 #include "CLI11.hpp"
 
 #include "core.hpp"
+#include "schedule.hpp"
 #include "rash/pool.hpp"
 
 
-constexpr int START_LENGTH_THRESHOLD = 65;
+// runs read ahead per worker with --stream.
+constexpr int STREAM_RUNS_PER_WORKER = 4;
+
+// runs are batched into one task until their estimated cost, in cells of
+// the alignment matrices, reaches this.
+constexpr double MIN_BATCH_COST = 1 << 20;
+
+// records waiting for the output threads.
+constexpr int OUTPUT_QUEUE_SIZE = 1024;
 
 struct MetaInfo {
-    std::string name;
-    std::string target;
+    core::u32 target;
     int left;
     int right;
     int loss;
     int reversed;
 };
 
-auto load_locate_file(const std::string &path) {
-    std::fstream fp(path);
+// the locations of a locate file, by run name. names are views into the
+// mapped record file, or into the names kept from a text file, so no name
+// is copied per lookup. references are numbered by target id, so that
+// they can be resolved once.
+class LocateTable {
+public:
+    // false if path looks like a record file but can not be used.
+    auto load(const std::string &path) -> bool {
+        // written by locate --binary.
+        if (core::is_record_file(path)) {
+            if (!_file.open(path))
+                return false;
+
+            auto records = _file.records<core::LocateRecord>();
+            std::vector<int> targets(_file.n_names(), -1);
+            _meta.reserve(records.size());
+            for (auto &r : records) {
+                if (targets[r.ref] < 0) {
+                    targets[r.ref] = _targets.size();
+                    _targets.push_back(_file.name(r.ref));
+                }
+
+                _meta[_file.name(r.run)] = {core::u32(targets[r.ref]), r.left, r.right, r.loss, r.reversed};
+            }
 
-    std::unordered_map<std::string, MetaInfo> meta;
-    while (fp) {
-        MetaInfo line;
-        fp >> line.name >> line.target >> line.left >> line.right >> line.loss >> line.reversed;
+            return true;
+        }
+
+        std::unordered_map<std::string_view, core::u32> targets;
+        std::fstream fp(path);
+        while (fp) {
+            std::string name, target;
+            MetaInfo line;
+            fp >> name >> target >> line.left >> line.right >> line.loss >> line.reversed;
+            if (name.empty() || target.empty())
+                continue;
+
+            auto it = targets.find(target);
+            if (it == targets.end()) {
+                _text.push_back(std::move(target));
+                it = targets.emplace(_text.back(), _targets.size()).first;
+                _targets.push_back(_text.back());
+            }
 
-        if (!line.name.empty() && !line.target.empty())
-            meta[line.name] = line;
+            line.target = it->second;
+            _text.push_back(std::move(name));
+            _meta[_text.back()] = line;
+        }
+
+        return true;
     }
 
-    return meta;
-}
+    auto find(std::string_view name) const -> const MetaInfo * {
+        auto it = _meta.find(name);
+        return it == _meta.end() ? nullptr : &it->second;
+    }
+
+    auto n_targets() const -> size_t {
+        return _targets.size();
+    }
+
+    auto target(core::u32 id) const -> std::string_view {
+        return _targets[id];
+    }
+
+private:
+    core::RecordFile _file;
+    std::deque<std::string> _text;
+    std::vector<std::string_view> _targets;
+    std::unordered_map<std::string_view, MetaInfo> _meta;
+};
 
 int main(int argc, char *argv[]) {
-    std::string ref_file, locate_file, runs_file, target;
+    std::string ref_file, locate_file, runs_file, target, output_file;
     double max_rate = 0.84;
     int n_workers = 1;
+    bool stream = false;
+    bool ordered = false;
+    bool binary = false;
 
     CLI::App args;
     args.add_option("-r", ref_file)->required();
@@ -42,129 +113,202 @@ int main(int argc, char *argv[]) {
     args.add_option("-t", target);
     args.add_option("-m", max_rate);
     args.add_option("-j", n_workers);
+    args.add_flag("--stream", stream, "read runs while dumping instead of loading them all first");
+    args.add_option("-o,--output", output_file, "file of the results, stderr by default");
+    args.add_flag("--ordered", ordered, "write the results in the order of the runs file");
+    args.add_flag("--binary", binary, "write the results to -o in the binary record format");
     CLI11_PARSE(args, argc, argv);
 
-    core::Dict refs, runs;
-    refs.load_file(ref_file);
-    printf("loaded \"%s\".\n", ref_file.data());
-    runs.load_file(runs_file);
-    printf("loaded \"%s\".\n", runs_file.data());
+    if (binary && output_file.empty()) {
+        fprintf(stderr, "--binary needs an output file.\n");
+        return -1;
+    }
+
+    // workers hand their lines to the writers instead of printing them.
+    // the record file is completed after the writers are done with it.
+    core::RecordFileWriter records;
+    core::RecordWriter log(OUTPUT_QUEUE_SIZE), results(OUTPUT_QUEUE_SIZE);
+    log.open(stdout, ordered);
+    if (binary && records.open<core::DumpRecord>(output_file)) {
+        results.open([&records](const std::string &s) {
+            records.write_encoded(s);
+        }, ordered);
+    } else if (output_file.empty())
+        results.open(stderr, ordered);
+    else if (binary || !results.open(output_file, ordered)) {
+        fprintf(stderr, "failed to create \"%s\".\n", output_file.data());
+        return -1;
+    }
 
-    auto meta = load_locate_file(locate_file);
-    printf("loaded \"%s\".\n", locate_file.data());
+    // the results are complete only once the writers are closed, the
+    // record file after the writer feeding it.
+    auto close_output = [&]() -> bool {
+        bool ok = results.close();
+        if (binary)
+            ok = records.close() && ok;
 
-    ThreadPool pool(n_workers);
-    std::vector<std::future<void>> futures;
-    futures.reserve(runs.size());
-    for (auto &run : runs) {
-        auto future = pool.run([&]() {
-            auto &info = meta[run.name];
-
-            auto rate = 1.0 - double(info.loss) / run.sequence.size();
-            if (rate > max_rate ||
-                (!target.empty() && run.name != target))
-                return;
-
-            if (info.reversed)
-                run.sequence = core::watson_crick_complement(run.sequence);
-
-            auto &ref = *refs.find(info.target);
-            auto s = core::BioSeq(ref.sequence, info.left, info.right + 1);
-            auto t = core::BioSeq(run.sequence);
-
-            auto prefix = core::prefix_span(s, t);
-            if (prefix.mark) {
-                s = core::BioSeq(ref.sequence,
-                    std::max(1UL, info.right - run.sequence.size() + 1),
-                    info.right + 1
-                );
-
-                printf("warn: triggered prefix correlation.\n");
-                prefix = core::prefix_span(s, t);
-            }
+        if (!ok)
+            fprintf(stderr, "failed to write \"%s\".\n", output_file.data());
+        return ok;
+    };
 
-            auto suffix = core::suffix_span(s, t);
-            if (suffix.mark) {
-                s = core::BioSeq(ref.sequence,
-                    info.left,
-                    std::min(ref.sequence.size(), info.left + run.sequence.size())
-                );
+    ThreadPool pool(n_workers);
 
-                printf("warn: triggered suffix correlation.\n");
-                suffix = core::suffix_span(s, t);
-            }
+    LocateTable meta;
+    if (meta.load(locate_file))
+        printf("loaded \"%s\".\n", locate_file.data());
+    else
+        printf("warn: \"%s\" is not a record file of version %u.\n", locate_file.data(), core::RECORD_VERSION);
 
-            bool contained = true;
-            core::Vec2i front, back;
-
-            int left = s.begin() - ref.sequence.begin() + 1;
-
-            if (prefix.range2.length() > START_LENGTH_THRESHOLD &&
-                prefix.range2.length() < run.sequence.size() - START_LENGTH_THRESHOLD) {
-                front = core::Vec2i(
-                    /*info.left*/ left + prefix.range1.end - 1,
-                    prefix.range2.end - 1
-                );
-            } else
-                contained = false;
-
-            if (suffix.range2.length() > START_LENGTH_THRESHOLD &&
-                suffix.range2.length() < run.sequence.size() - START_LENGTH_THRESHOLD) {
-                back = core::Vec2i(
-                    /*info.left*/ left + suffix.range1.begin - 2,
-                    suffix.range2.begin
-                );
-            } else
-                contained = false;
-
-            auto inv_match_rate = -1.0;
-            int l1 = front.x, r1 = back.x;
-            int l2 = front.y + 1, r2 = back.y - 1;
-            if (contained && 0 < l1 && l1 <= r1 && 0 < l2 && l2 <= r2) {
-                auto reversed = core::watson_crick_complement(
-                    run.sequence.substr(l2 - 1, r2 - l2 + 1)
-                );
-
-                int loss = core::full_align(
-                    core::BioSeq(ref.sequence, front.x, back.x + 1),
-                    reversed
-                );
-
-                inv_match_rate = 1 - 2.0 * loss / (r1 - l1 + 1 + r2 - l2 + 1);
+    core::Dict refs, runs;
+    if (!target.empty()) {
+        // only the run and its reference are fetched, through the
+        // indices of the files.
+        stream = false;
+        auto info = meta.find(target);
+        if (!info) {
+            fprintf(stderr, "%s is not in \"%s\".\n", target.data(), locate_file.data());
+            return -1;
+        }
+
+        std::string ref_name(meta.target(info->target));
+        if (!refs.load_records(ref_file, {ref_name})) {
+            fprintf(stderr, "failed to load %s from \"%s\".\n", ref_name.data(), ref_file.data());
+            return -1;
+        }
+        printf("loaded %s from \"%s\".\n", ref_name.data(), ref_file.data());
+
+        if (!runs.load_records(runs_file, {target})) {
+            fprintf(stderr, "failed to load %s from \"%s\".\n", target.data(), runs_file.data());
+            return -1;
+        }
+        printf("loaded %s from \"%s\".\n", target.data(), runs_file.data());
+    } else {
+        if (!refs.load_file(ref_file, false, &pool)) {
+            fprintf(stderr, "failed to load \"%s\".\n", ref_file.data());
+            return -1;
+        }
+        printf("loaded \"%s\".\n", ref_file.data());
+
+        if (!stream) {
+            if (!runs.load_file(runs_file, false, &pool)) {
+                fprintf(stderr, "failed to load \"%s\".\n", runs_file.data());
+                return -1;
             }
+            printf("loaded \"%s\".\n", runs_file.data());
+        }
+    }
 
-            printf(
-                "%s @%s[%d, %d]: %%=%.3lf, n=%d, m=%d, [%d, %d)-[%d, %d)=%d, [%d, %d)-[%d, %d)=%d\n",
-                run.name.data(),
-                ref.name.data(),
-                info.left, info.right,
-                rate, s.size(), t.size(),
-                prefix.range1.begin, prefix.range1.end,
-                prefix.range2.begin, prefix.range2.end,
-                prefix.loss,
-                suffix.range1.begin, suffix.range1.end,
-                suffix.range2.begin, suffix.range2.end,
-                suffix.loss
-            );
+    // the references by target id, null for those not loaded.
+    std::vector<core::DictEntry *> targets(meta.n_targets());
+    for (core::u32 i = 0; i < targets.size(); i++) {
+        targets[i] = refs.find(std::string(meta.target(i)));
+    }
 
-            int dist1 = front.y > 0 ? ((back.y > 0 ? back.y : run.sequence.size()) - front.y) : 0;
-            int dist2 = back.y > 0 ? (back.y - front.y) : 0;
-            fprintf(stderr,
+    // `id` is the number of the output records of `run`.
+    // workers share meta, so it is only searched, never inserted into.
+    // runs without a location, or located on a reference that is not
+    // loaded, are skipped.
+    auto process = [&](core::DictEntry &run, core::u64 id) {
+        auto info = meta.find(run.name);
+        if (!info) {
+            log.write(id, "");
+            results.write(id, "");
+            return;
+        }
+
+        std::string lines, record;
+        auto rate = 1.0 - double(info->loss) / run.sequence.size();
+        auto ptr = targets[info->target];
+        if (rate > max_rate ||
+            (!target.empty() && run.name != target) ||
+            !ptr) {
+            log.write(id, "");
+            results.write(id, "");
+            return;
+        }
+
+        auto &ref = *ptr;
+
+        core::Placement p = {0, info->left, info->right, info->loss, bool(info->reversed), {}};
+        auto b = core::find_breakpoints(ref, run, p, lines);
+        if (binary) {
+            core::DumpRecord r = {
+                0, 0,
+                b.front_x, b.front_y, b.front_distance,
+                b.back_x, b.back_y, b.back_distance,
+                b.inv_match_rate
+            };
+            record = core::encode_record(run.name, ref.name, r);
+        } else {
+            core::appendf(record,
                 "%s %s %d %d %d %d %d %d %.16lf\n",
                 run.name.data(),
                 ref.name.data(),
-                front.x, front.y, std::abs(dist1),
-                back.x, back.y, std::abs(dist2),
-                inv_match_rate
+                b.front_x, b.front_y, b.front_distance,
+                b.back_x, b.back_y, b.back_distance,
+                b.inv_match_rate
             );
+        }
+
+        log.write(id, std::move(lines));
+        results.write(id, std::move(record));
+    };
+
+    // the spans align a run against its located window. runs without a
+    // location are skipped right away.
+    auto estimate_cost = [&meta](const core::DictEntry &run) -> double {
+        auto info = meta.find(run.name);
+        if (!info)
+            return 0;
+
+        return double(run.sequence.size()) * std::max(1, info->right - info->left + 1);
+    };
+
+    core::WorkerClock clock(pool.size());
+    if (!stream) {
+        // the longest runs go first, so that no worker is left alone with
+        // one at the end.
+        std::vector<core::u64> ids(runs.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        auto batches = core::plan_batches(ids, [&](core::u64 id) {
+            return estimate_cost(runs[id]);
+        }, MIN_BATCH_COST);
+
+        core::run_batches(pool, batches, clock, [&](core::u64 id) {
+            process(runs[id], id);
         });
 
-        futures.push_back(std::move(future));
+        log.flush();
+        results.flush();
+
+        clock.print("dump");
+        return close_output() ? 0 : -1;
+    }
+
+    // the workers take runs from the stream, a few per worker at a time.
+    core::ReadStream reads(STREAM_RUNS_PER_WORKER * pool.size());
+    if (!reads.open(runs_file)) {
+        fprintf(stderr, "failed to open \"%s\".\n", runs_file.data());
+        return -1;
     }
 
-    for (auto &f : futures) {
-        f.get();
+    TaskGroup group(pool);
+    for (int k = 0; k < pool.size(); k++) {
+        group.run([&, k] {
+            size_t id;
+            while (auto run = reads.next(&id)) {
+                clock.time(k, [&] {
+                    process(*run, id);
+                });
+            }
+        });
     }
 
-    return 0;
+    group.wait();
+    log.flush();
+    results.flush();
+    clock.print("dump");
+
+    return close_output() ? 0 : -1;
 }
@@ -2,18 +2,27 @@
 
 #include <cstdint>
 
+#include <array>
 #include <vector>
 #include <string>
+#include <concepts>
 
 
 namespace core {
 
 using i8 = std::int8_t;
 using u8 = std::uint8_t;
+using i32 = std::int32_t;
+using u32 = std::uint32_t;
 using i64 = std::int64_t;
 using u64 = std::uint64_t;
 
 bool startswith(const std::string &target, const std::string &pattern);
+
+// the i-th reference (1-indexed, sorted by name) is "S<i>", and the runs
+// simulated from it are named "S<i>_*".
+auto reference_id(int i) -> std::string;
+auto run_prefix(int i) -> std::string;
 auto watson_crick_complement(const std::string &s) -> std::string;
 
 // Sequence is 1-indexed.
@@ -75,6 +84,65 @@ private:
 
 using BioSeq = Slice<char, std::basic_string<char>>;
 
+// base-wise table of watson_crick_complement().
+inline constexpr auto COMPLEMENT = [] {
+    std::array<char, 256> table;
+    table.fill('N');
+    table['A'] = 'T';
+    table['T'] = 'A';
+    table['C'] = 'G';
+    table['G'] = 'C';
+    return table;
+}();
+
+// 1-indexed sequences the alignment kernels accept: BioSeq, PackedView
+// and their RevComp.
+template <typename T>
+concept Sequence = requires(const T &s, int i) {
+    { s.size() } -> std::convertible_to<int>;
+    { s[i] } -> std::convertible_to<char>;
+    { s.take(i, i) } -> std::same_as<T>;
+};
+
+// reverse complement of a sequence, complemented on access instead of
+// copied. 1-indexed as well.
+template <Sequence TSeq>
+class RevComp {
+public:
+    explicit RevComp(const TSeq &s) : _s(s) {}
+
+    auto size() const -> int {
+        return _s.size();
+    }
+
+    auto operator[](int i) const -> char {
+        return COMPLEMENT[static_cast<u8>(_s[_s.size() + 1 - i])];
+    }
+
+    auto take(int begin, int end) const -> RevComp {
+        int n = _s.size();
+        return RevComp(_s.take(n + 2 - end, n + 2 - begin));
+    }
+
+    // the sequence this is the reverse complement of.
+    auto base() const -> const TSeq & {
+        return _s;
+    }
+
+private:
+    TSeq _s;
+};
+
+template <Sequence TSeq>
+auto reverse_complement(const TSeq &s) -> RevComp<TSeq> {
+    return RevComp<TSeq>(s);
+}
+
+template <Sequence TSeq>
+auto reverse_complement(const RevComp<TSeq> &s) -> TSeq {
+    return s.base();
+}
+
 struct Range {
     int begin, end;
 
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+
+class ThreadPool;
+
+namespace core {
+
+enum class Compression {
+    NONE,
+    GZIP,
+    // gzip made of independent blocks of at most 64 KiB, as written by
+    // bgzip. any gzip reader can decode it.
+    BGZF,
+    ZSTD,
+};
+
+// guessed from the magic bytes at the start of a file.
+auto detect_compression(const char *data, size_t size) -> Compression;
+
+// decodes a whole compressed file image into out. BGZF blocks are
+// inflated in parallel when a pool is given. zstd is only supported
+// when built with TASK2_ZSTD. false on corrupt or unsupported input.
+auto decompress(const char *data, size_t size, std::string &out, ThreadPool *pool = nullptr) -> bool;
+
+// reads a file sequentially, decoding it on the fly if it is compressed.
+class DecodingReader {
+public:
+    DecodingReader() = default;
+    ~DecodingReader();
+
+    DecodingReader(const DecodingReader &) = delete;
+    auto operator=(const DecodingReader &) = delete;
+
+    auto open(const std::string &path) -> bool;
+    void close();
+
+    // fills up to size bytes of buffer. 0 at the end of the file and -1
+    // on corrupt input.
+    auto read(char *buffer, size_t size) -> i64;
+
+private:
+    int _fd = -1;
+    Compression _type = Compression::NONE;
+
+    // gzFile of GZIP and BGZF, ZSTD_DStream of ZSTD.
+    void *_state = nullptr;
+
+    // compressed bytes waiting for the zstd decoder.
+    std::vector<char> _input;
+    size_t _input_pos = 0, _input_end = 0;
+};
+
+}
@@ -2,5 +2,12 @@
 
 #include "common.hpp"
 #include "dict.hpp"
+#include "file.hpp"
 #include "index.hpp"
+#include "minimizer.hpp"
 #include "numeric.hpp"
+#include "record.hpp"
+#include "stages.hpp"
+#include "stream.hpp"
+#include "sv.hpp"
+#include "writer.hpp"
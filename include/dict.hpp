@@ -2,8 +2,15 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
+#include "file.hpp"
+#include "packed.hpp"
+#include "compress.hpp"
+
+
+class ThreadPool;
 
 namespace core {
 
@@ -11,20 +18,36 @@ struct DictEntry {
     DictEntry() = default;
     DictEntry(const DictEntry &) = default;
     DictEntry(DictEntry &&) = default;
-    DictEntry(const std::string &_name, const std::string &_sqeuence)
-        : name(_name), sequence(_sqeuence) {}
+    DictEntry(std::string _name, std::string _sequence)
+        : name(std::move(_name)), sequence(std::move(_sequence)) {}
 
     DictEntry &operator=(const DictEntry &) = default;
     DictEntry &operator=(DictEntry &&) = default;
 
     std::string name;
     std::string sequence;
+
+    // filled instead of sequence when the dict is loaded packed.
+    PackedSeq packed;
 };
 
 // load a single FASTA file into an ordered list of dict entries.
 class Dict {
 public:
-    void load_file(const std::string &path);
+    // the file is mapped and scanned in place, and sequences may be
+    // wrapped over several lines. with packed, each sequence is stored
+    // 2-bit packed in DictEntry::packed and DictEntry::sequence is left
+    // empty. the file is parsed in parallel chunks when a pool is given.
+    // false, leaving the dict empty, if the file can not be read or
+    // decoded, as a zstd file without zstd support.
+    auto load_file(const std::string &path, bool packed = false, ThreadPool *pool = nullptr) -> bool;
+
+    // loads only the named records, in the given order, through the
+    // FastaIndex of the file. false if the file can not be read or a
+    // name is missing from it, the records found being loaded anyway.
+    auto load_records(
+        const std::string &path, const std::vector<std::string> &names, bool packed = false
+    ) -> bool;
     void sort_by_name();
     void build_index();
     auto find(const std::string &name) const -> DictEntry *;
@@ -64,4 +87,76 @@ private:
     std::unordered_map<std::string, DictEntry *> _index;
 };
 
+// name -> position table of a FASTA file, saved as a "<path>.t2idx"
+// sidecar next to it and rebuilt when the file changes size or mtime.
+// names are whole header lines, as in Dict, so the format is our own
+// and a samtools "<path>.fai" is left alone.
+// records are read straight out of a mapping of the file. compressed
+// files are decoded as a whole, so they gain nothing from the index.
+class FastaIndex {
+public:
+    struct Record {
+        std::string name;
+        size_t length;
+        size_t offset;
+        int line_bases;
+        int line_width;
+    };
+
+    auto open(const std::string &path) -> bool;
+
+    auto size() const -> size_t {
+        return _records.size();
+    }
+
+    auto find(const std::string &name) const -> const Record *;
+
+    // false if there is no record called name.
+    auto fetch(const std::string &name, DictEntry &e, bool packed = false) const -> bool;
+
+private:
+    MappedFile _file;
+    std::string _decoded;
+    const char *_data = nullptr;
+    size_t _size = 0;
+
+    std::vector<Record> _records;
+    std::unordered_map<std::string, int> _index;
+
+    void _scan();
+    auto _load(const std::string &path, const FileStamp &stamp) -> bool;
+    auto _save(const std::string &path, const FileStamp &stamp) const -> bool;
+};
+
+// reads the records of a FASTA file one at a time, through a fixed-size
+// buffer. records are parsed as by Dict::load_file(), and compressed
+// files are decoded on the fly.
+class FastaReader {
+public:
+    FastaReader() = default;
+    ~FastaReader();
+
+    FastaReader(const FastaReader &) = delete;
+    auto operator=(const FastaReader &) = delete;
+
+    auto open(const std::string &path) -> bool;
+    void close();
+
+    // false at the end of the file.
+    auto next(DictEntry &e, bool packed = false) -> bool;
+
+private:
+    DecodingReader _input;
+    bool _eof = false;
+    std::vector<char> _buffer;
+    size_t _begin = 0, _end = 0;
+
+    // header read past the end of the previous record.
+    std::string _header;
+    bool _has_header = false;
+
+    // the line stays valid until the next call.
+    auto _getline(std::string_view &line) -> bool;
+};
+
 }
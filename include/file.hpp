@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include "common.hpp"
+
+
+namespace core {
+
+// read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&rhs);
+    auto operator=(const MappedFile &) = delete;
+    auto operator=(MappedFile &&rhs) -> MappedFile &;
+
+    auto open(const std::string &path) -> bool;
+    void close();
+
+    auto data() const -> const char * {
+        return _data;
+    }
+
+    auto size() const -> size_t {
+        return _size;
+    }
+
+    auto empty() const -> bool {
+        return _size == 0;
+    }
+
+private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+};
+
+// size and modification time of a file, the latter in nanoseconds.
+// either changes when the file is rewritten.
+struct FileStamp {
+    u64 size = 0;
+    i64 mtime = 0;
+
+    bool operator==(const FileStamp &rhs) const = default;
+};
+
+// false if the file can not be found.
+auto stamp_file(const std::string &path, FileStamp &stamp) -> bool;
+
+}
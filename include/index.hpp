@@ -1,10 +1,16 @@
 #pragma once
 
+#include <span>
 #include <limits>
+#include <memory>
 
 #include "common.hpp"
+#include "file.hpp"
+#include "packed.hpp"
 
 
+class ThreadPool;
+
 namespace core {
 
 constexpr int ALPHABET_SIZE = 5;
@@ -57,13 +63,93 @@ struct Alignment {
     }
 };
 
+// the templates below are instantiated for s1 a BioSeq and s2 a BioSeq or
+// RevComp<BioSeq>, and likewise for PackedView. the non-template versions
+// also take std::string through the implicit BioSeq conversion.
 auto full_align(const BioSeq &s1, const BioSeq &s2) -> int;
+template <Sequence TSeq1, Sequence TSeq2>
+auto full_align(const TSeq1 &s1, const TSeq2 &s2) -> int;
+auto full_align_scalar(const BioSeq &s1, const BioSeq &s2) -> int;
+auto full_align_bitwise(const BioSeq &s1, const BioSeq &s2) -> int;
 auto local_align(const BioSeq &s1, const BioSeq &s2) -> Alignment;
+template <Sequence TSeq1, Sequence TSeq2>
+auto local_align(const TSeq1 &s1, const TSeq2 &s2) -> Alignment;
+auto local_align_scalar(const BioSeq &s1, const BioSeq &s2) -> Alignment;
+// local_align() restricted to cells with |i - j - diagonal| <= width, then
+// to a band wider by the loss found there. the result equals local_align()
+// unless every better path lies wholly outside the first band.
+auto banded_local_align(const BioSeq &s1, const BioSeq &s2, int diagonal, int width) -> Alignment;
+template <Sequence TSeq1, Sequence TSeq2>
+auto banded_local_align(const TSeq1 &s1, const TSeq2 &s2, int diagonal, int width) -> Alignment;
 auto concat_align(const BioSeq &s1, const BioSeq &s2) -> Alignment;
 
 auto sublocal_span(const BioSeq &s1, const BioSeq &s2) -> Alignment;
 auto prefix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment;
+template <Sequence TSeq1, Sequence TSeq2>
+auto prefix_span(const TSeq1 &s1, const TSeq2 &s2) -> Alignment;
 auto suffix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment;
+template <Sequence TSeq1, Sequence TSeq2>
+auto suffix_span(const TSeq1 &s1, const TSeq2 &s2) -> Alignment;
+
+class MinimizerTable;
+
+// seeding of Index::fuzzy_locate().
+struct LocateOptions {
+    // look k-mers up exactly first and run A* only on those that miss.
+    bool exact_seeds = true;
+
+    // seed at the read's minimizers instead of every STEP-th k-mer. those
+    // missing from the table are seeded as usual.
+    const MinimizerTable *minimizers = nullptr;
+};
+
+// search state of Index::align(). keeping one per thread lets the heap
+// and the hash table reuse their storage across calls.
+class AlignWorkspace {
+public:
+    AlignWorkspace();
+    ~AlignWorkspace();
+
+    AlignWorkspace(AlignWorkspace &&) = default;
+    auto operator=(AlignWorkspace &&) -> AlignWorkspace & = default;
+
+private:
+    friend class Index;
+
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+// the text of an index, as its length and a 64-bit FNV-1a hash of its
+// characters. it takes the same appends as Index, and an image is only
+// loaded for the text it was saved from.
+class TextFingerprint {
+public:
+    void append(int c) {
+        _length++;
+        _hash = (_hash ^ u64(c)) * 0x100000001b3;
+    }
+
+    void append(const BioSeq &s);
+    void append(const PackedView &s);
+    void append_reference(const BioSeq &s);
+    void append_reference(const PackedView &s);
+
+    auto length() const -> i64 {
+        return _length;
+    }
+
+    auto hash() const -> u64 {
+        return _hash;
+    }
+
+private:
+    i64 _length = 0;
+    u64 _hash = 0xcbf29ce484222325;
+
+    template <Sequence TSeq>
+    void _append_sequence(const TSeq &s);
+};
 
 class Index {
 public:
@@ -72,10 +158,25 @@ public:
         int len = 0;
     };
 
+    struct SeedStats {
+        int n_table = 0;
+        int n_repetitive = 0;
+        int n_exact = 0;
+        int n_aligned = 0;
+        int64_t n_state_visited = 0;
+    };
+
+    // left and right are relative to reference ref. the seeds put the
+    // reference position minus the read position within diagonal ± spread,
+    // on the same scale.
     struct Location {
         bool reversed;
+        int ref = 0;
         int left;
         int right;
+        int diagonal = 0;
+        int spread = 0;
+        SeedStats seeds;
     };
 
     struct AlignmentDebugInfo {
@@ -91,42 +192,105 @@ public:
 
     Index();
 
+    Index(const Index &) = delete;
+    Index(Index &&) = default;
+    auto operator=(const Index &) = delete;
+    auto operator=(Index &&) -> Index & = default;
+
     auto size() const -> int {
         return _n_appended;
     }
 
     void append(int c);
     void append(const BioSeq &s);
-    void build();
+    void append(const PackedView &s);
+
+    // appends s and a separator as a separate reference. positions
+    // from rpset() map back to references through reference_of().
+    void append_reference(const BioSeq &s);
+    void append_reference(const PackedView &s);
+
+    auto n_references() const -> int;
+    auto reference_of(int pos) const -> int;
+    auto reference_range(int ref) const -> Range;
+
+    // the fail tree is numbered in parallel when a pool is given.
+    void build(ThreadPool *pool = nullptr);
+
+    // binary image of a built index. load() maps the image read-only
+    // and serves queries directly from the mapping. it fails unless the
+    // image was saved from an index of the same text.
+    auto save(const std::string &path) const -> bool;
+    auto load(const std::string &path, const TextFingerprint &text) -> bool;
 
     auto rpset(const Token &t) const -> std::vector<int>;
 
     auto next(const Token &t, int c) const -> Token;
     auto locate(const BioSeq &s) const -> Token;
+    // without a workspace, a thread-local one is used.
     auto align(const BioSeq &s) const -> Alignment;
+    auto align(const BioSeq &s, AlignWorkspace &workspace) const -> Alignment;
+    template <Sequence TSeq>
+    auto align(const TSeq &s, AlignWorkspace &workspace) const -> Alignment;
     auto fuzzy_locate(const BioSeq &s) const -> Location;
+    auto fuzzy_locate(
+        const BioSeq &s, AlignWorkspace &workspace, const LocateOptions &options = {}
+    ) const -> Location;
+    auto fuzzy_locate(
+        const PackedView &s, AlignWorkspace &workspace, const LocateOptions &options = {}
+    ) const -> Location;
 
 private:
-    struct Node {
-        int maxlen = 0, fail = 0;
-        int index = 0;
-        int transition[ALPHABET_SIZE] = {0};
-
-        struct {
-            int in = 0, out = 0;
-        } dfn;
-        std::vector<int> children;
-    };
+    // owned storage, one slot per state (structure of arrays).
+    // transition rows are ALPHABET_SIZE wide. _index is only needed
+    // by build() and is not part of the image.
+    struct {
+        std::vector<int> transition;
+        std::vector<int> fail, maxlen, index;
+        std::vector<Range> dfn;
+        std::vector<int> sorted;
+        std::vector<int> starts;
+    } _data;
+
+    // queries go through these views, which refer either to the
+    // vectors above or into a mapped image. dfn is [in, out + 1).
+    // reference k occupies positions (starts[k], starts[k + 1]), the
+    // last one being its separator.
+    struct {
+        std::span<const int> transition;
+        std::span<const int> fail, maxlen;
+        std::span<const Range> dfn;
+        std::span<const int> sorted;
+        std::span<const int> starts;
+    } _view;
 
     int _last = 1;
     int _n_appended = 0;
-    std::vector<Node> m;
-    std::vector<int> _sorted;
+    TextFingerprint _text;
+    MappedFile _image;
+
+    auto _transition(int x, int c) -> int & {
+        return _data.transition[x * ALPHABET_SIZE + c];
+    }
 
     auto _allocate(int n) -> int;
     void _copy(int dst, int src);
     auto _append(int x, int c) -> int;
-    void _traverse(int x, int &count);
+    void _attach();
+
+    template <Sequence TSeq>
+    void _append_sequence(const TSeq &s);
+    template <Sequence TSeq>
+    void _append_reference(const TSeq &s);
+
+    template <Sequence TSeq>
+    auto _fuzzy_locate(
+        const TSeq &s, AlignWorkspace &workspace, const LocateOptions &options
+    ) const -> Location;
+
+    // longest prefix of s that occurs in the reference, without fail links.
+    template <Sequence TSeq>
+    auto _walk(const TSeq &s) const -> Token;
 };
 
 }
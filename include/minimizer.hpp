@@ -0,0 +1,66 @@
+#pragma once
+
+#include <span>
+#include <optional>
+
+#include "common.hpp"
+
+
+namespace core {
+
+// the k-mer of smallest hash in a window of w consecutive k-mers.
+struct Minimizer {
+    u64 hash;
+    int pos;  // start of the k-mer.
+};
+
+// minimizers of s in order, each reported once. k-mers with characters
+// other than ACGT break the windows. k is at most 32.
+// instantiated for BioSeq, PackedView and their RevComp.
+template <Sequence TSeq>
+auto minimizers(const TSeq &s, int w, int k) -> std::vector<Minimizer>;
+
+// reference positions of the reference minimizers. positions are those of
+// an Index filled by the same sequence of append()/append_reference().
+class MinimizerTable {
+public:
+    // minimizers occurring more than max_occurrence times are dropped.
+    // append() and append_reference() take a BioSeq or a PackedView.
+    MinimizerTable(int w, int k, int max_occurrence);
+
+    auto window() const -> int {
+        return _w;
+    }
+
+    auto kmer() const -> int {
+        return _k;
+    }
+
+    auto size() const -> size_t {
+        return _positions.size();
+    }
+
+    template <Sequence TSeq>
+    void append(const TSeq &s);
+    template <Sequence TSeq>
+    void append_reference(const TSeq &s);
+    void build();
+
+    // end positions of the k-mers with this hash. nullopt if it is not a
+    // reference minimizer, empty if it was dropped as repetitive.
+    auto find(u64 hash) const -> std::optional<std::span<const int>>;
+
+private:
+    int _w, _k, _max_occurrence;
+    int _n_appended = 0;
+
+    // (hash, end position), until build().
+    std::vector<std::pair<u64, int>> _entries;
+
+    // positions of _hashes[i] are _positions[_offsets[i].._offsets[i + 1]).
+    std::vector<u64> _hashes;
+    std::vector<int> _offsets;
+    std::vector<int> _positions;
+};
+
+}
@@ -147,4 +147,8 @@ struct Decomposition {
 
 auto french_stick_decompose(const std::vector<Vec2d> &vs, int K) -> Decomposition;
 
+// the search french_stick_decompose() replaced, which builds every
+// prefix hull in full. same result, kept for bench.
+auto french_stick_decompose_naive(const std::vector<Vec2d> &vs, int K) -> Decomposition;
+
 }
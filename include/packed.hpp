@@ -0,0 +1,87 @@
+#pragma once
+
+#include "common.hpp"
+
+
+namespace core {
+
+class PackedView;
+
+// DNA at 2 bits per base, A/C/G/T being 0..3. characters other than ACGT
+// (in either case) are kept as runs of N in a side table, so a packed
+// sequence reads back as uppercase ACGT and N.
+//
+// this only saves memory. the kernels read one base at a time, and every
+// read decodes it from its word, so they run no faster on a packed
+// sequence than on a string, and usually a little slower.
+class PackedSeq {
+public:
+    PackedSeq() = default;
+    explicit PackedSeq(const std::string &s);
+
+    auto size() const -> int {
+        return _size;
+    }
+
+    auto empty() const -> bool {
+        return _size == 0;
+    }
+
+    // 1-indexed.
+    auto operator[](int i) const -> char {
+        if (!_n_runs.empty() && is_n(i))
+            return 'N';
+        return "ACGT"[_bits(i - 1)];
+    }
+
+    auto is_n(int i) const -> bool;
+
+    auto view() const -> PackedView;
+    auto unpack() const -> std::string;
+
+    // bytes of storage held.
+    auto memory() const -> size_t;
+
+private:
+    int _size = 0;
+    std::vector<u64> _words;
+
+    // [begin, end) of the N runs, 1-indexed and increasing.
+    std::vector<Range> _n_runs;
+
+    // base p (0-indexed) sits at bits 2 (p % 32) of word p / 32.
+    auto _bits(int p) const -> int {
+        return (_words[p >> 5] >> ((p & 31) << 1)) & 3;
+    }
+};
+
+// 1-indexed slice of a PackedSeq, as BioSeq is of a std::string.
+class PackedView {
+public:
+    PackedView() = default;
+    PackedView(const PackedSeq &seq) : PackedView(seq, 1, seq.size() + 1) {}
+    PackedView(const PackedSeq &seq, int begin, int end)
+        : _seq(&seq), _offset(begin - 1), _size(end - begin) {}
+
+    auto size() const -> int {
+        return _size;
+    }
+
+    auto operator[](int i) const -> char {
+        return (*_seq)[_offset + i];
+    }
+
+    auto take(int begin, int end) const -> PackedView {
+        return PackedView(*_seq, _offset + begin, _offset + end);
+    }
+
+private:
+    const PackedSeq *_seq = nullptr;
+    int _offset = 0, _size = 0;
+};
+
+inline auto PackedSeq::view() const -> PackedView {
+    return PackedView(*this);
+}
+
+}
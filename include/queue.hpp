@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <condition_variable>
+
+
+namespace core {
+
+// fifo shared between threads. push() blocks while the queue is full,
+// which holds producers back to the pace of the consumers.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity) {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    auto operator=(const BoundedQueue &) = delete;
+
+    // false if the queue has been closed, in which case value is dropped.
+    auto push(T value) -> bool {
+        std::unique_lock lock(_mutex);
+        _not_full.wait(lock, [this] {
+            return _closed || _items.size() < _capacity;
+        });
+
+        if (_closed)
+            return false;
+
+        _items.push_back(std::move(value));
+        lock.unlock();
+        _not_empty.notify_one();
+        return true;
+    }
+
+    // nullopt once the queue is closed and drained.
+    auto pop() -> std::optional<T> {
+        std::unique_lock lock(_mutex);
+        _not_empty.wait(lock, [this] {
+            return _closed || !_items.empty();
+        });
+
+        if (_items.empty())
+            return std::nullopt;
+
+        auto value = std::move(_items.front());
+        _items.pop_front();
+        lock.unlock();
+        _not_full.notify_one();
+        return value;
+    }
+
+    // wakes up every waiting thread. items already queued can still be
+    // popped.
+    void close() {
+        {
+            std::lock_guard guard(_mutex);
+            _closed = true;
+        }
+
+        _not_full.notify_all();
+        _not_empty.notify_all();
+    }
+
+private:
+    size_t _capacity;
+    bool _closed = false;
+    std::mutex _mutex;
+    std::condition_variable _not_full, _not_empty;
+    std::deque<T> _items;
+};
+
+}
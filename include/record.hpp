@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "file.hpp"
+
+
+namespace core {
+
+// binary results of locate and dump, as an alternative to their text
+// lines. a file is a header, an array of fixed-width records of one
+// type, and a table of the names they refer to by id, so that it can be
+// used straight from a memory mapping. numbers are stored in the byte
+// order of the machine that wrote them.
+//
+//     header                      RecordHeader
+//     records                     n_records × record_size bytes
+//     name table at names_offset  u32 n_names, u32 offsets[n_names + 1],
+//                                 then the names back to back
+
+constexpr char RECORD_MAGIC[4] = {'T', '2', 'R', 'F'};
+
+// bumped on every change of the layout. older files are rejected.
+constexpr u32 RECORD_VERSION = 1;
+
+enum class RecordType : u32 {
+    LOCATE = 1,
+    DUMP = 2,
+};
+
+struct RecordHeader {
+    char magic[4];
+    u32 version;
+    RecordType type;
+    u32 record_size;
+    u64 n_records;
+    u64 names_offset;
+};
+
+// a line of locate. every record starts with the ids of the run and
+// the reference.
+struct LocateRecord {
+    static constexpr auto TYPE = RecordType::LOCATE;
+
+    u32 run, ref;
+    i32 left, right;
+    i32 loss;
+    i32 reversed;
+};
+
+// a line of dump. front and back are the breakpoints, 0 when not found.
+struct DumpRecord {
+    static constexpr auto TYPE = RecordType::DUMP;
+
+    u32 run, ref;
+    i32 front_x, front_y, front_distance;
+    i32 back_x, back_y, back_distance;
+    double inv_match_rate;
+};
+
+static_assert(sizeof(RecordHeader) % alignof(DumpRecord) == 0);
+
+// whether path starts like a record file.
+auto is_record_file(const std::string &path) -> bool;
+
+// a record file mapped into memory.
+class RecordFile {
+public:
+    // false if path is not a record file of this version, or if its
+    // records or names do not fit in the file. the ids of all records are
+    // checked against the name table here.
+    auto open(const std::string &path) -> bool;
+
+    auto type() const -> RecordType {
+        return _header->type;
+    }
+
+    auto n_names() const -> size_t {
+        return _n_names;
+    }
+
+    // id is below n_names(), as are all ids in the records.
+    auto name(u32 id) const -> std::string_view {
+        return std::string_view(_names + _offsets[id], _offsets[id + 1] - _offsets[id]);
+    }
+
+    // all names, indexed by id, for readers that need them as strings.
+    auto names() const -> std::vector<std::string>;
+
+    // empty if the file holds records of another type.
+    template <typename T>
+    auto records() const -> std::span<const T> {
+        if (type() != T::TYPE)
+            return {};
+
+        auto begin = reinterpret_cast<const T *>(_file.data() + sizeof(RecordHeader));
+        return std::span<const T>(begin, _header->n_records);
+    }
+
+private:
+    MappedFile _file;
+    const RecordHeader *_header = nullptr;
+    size_t _n_names = 0;
+    const u32 *_offsets = nullptr;
+    const char *_names = nullptr;
+};
+
+// a record and the names it refers to, flattened into a string to be
+// passed to the thread writing the file.
+template <typename T>
+auto encode_record(std::string_view run, std::string_view ref, const T &r) -> std::string {
+    std::string s;
+    s.reserve(run.size() + ref.size() + 2 + sizeof(T));
+    s.append(run);
+    s.push_back('\0');
+    s.append(ref);
+    s.push_back('\0');
+    s.append(reinterpret_cast<const char *>(&r), sizeof(T));
+    return s;
+}
+
+// writes a record file. names are interned as they first come up.
+// not safe to use from several threads.
+class RecordFileWriter {
+public:
+    RecordFileWriter() = default;
+    ~RecordFileWriter();
+
+    RecordFileWriter(const RecordFileWriter &) = delete;
+    auto operator=(const RecordFileWriter &) = delete;
+
+    template <typename T>
+    auto open(const std::string &path) -> bool {
+        return _open(path, T::TYPE, sizeof(T));
+    }
+
+    // ids of r are replaced with those of run and ref.
+    template <typename T>
+    void write(std::string_view run, std::string_view ref, T r) {
+        r.run = _intern(run);
+        r.ref = _intern(ref);
+        fwrite(&r, sizeof(T), 1, _fp);
+        _n_records++;
+    }
+
+    // writes the output of encode_record().
+    void write_encoded(std::string_view s);
+
+    // appends the name table and completes the header. false on any
+    // write error.
+    auto close() -> bool;
+
+private:
+    FILE *_fp = nullptr;
+    RecordHeader _header;
+    u64 _n_records = 0;
+    std::string _names;
+    std::vector<u32> _offsets;
+    std::unordered_map<std::string, u32> _ids;
+
+    auto _open(const std::string &path, RecordType type, size_t record_size) -> bool;
+    auto _intern(std::string_view name) -> u32;
+};
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "rash/pool.hpp"
+
+
+namespace core {
+
+// items grouped into batches of at least min_cost estimated work, the
+// most expensive first. an item costing min_cost or more is a batch of
+// its own, while cheap items share one task.
+template <typename T, typename TCostFn>
+auto plan_batches(
+    const std::vector<T> &items, const TCostFn &cost, double min_cost
+) -> std::vector<std::vector<T>> {
+    std::vector<std::pair<double, T>> order;
+    order.reserve(items.size());
+    for (auto &item : items) {
+        order.emplace_back(cost(item), item);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [](const auto &u, const auto &v) {
+        return u.first > v.first;
+    });
+
+    std::vector<std::vector<T>> batches;
+    double sum = 0;
+    for (auto &[c, item] : order) {
+        if (batches.empty() || sum >= min_cost) {
+            batches.emplace_back();
+            sum = 0;
+        }
+
+        batches.back().push_back(item);
+        sum += c;
+    }
+
+    return batches;
+}
+
+// wall time since construction and busy time of every worker.
+class WorkerClock {
+public:
+    explicit WorkerClock(int n_workers)
+        : _start(std::chrono::steady_clock::now()), _busy(n_workers) {}
+
+    auto size() const -> int {
+        return _busy.size();
+    }
+
+    // runs fn and counts it as busy time of worker k. only one thread
+    // may time a given worker.
+    template <typename TFn>
+    void time(int k, TFn &&fn) {
+        double idle = _idle;
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        _busy[k] += elapsed - (_idle - idle);
+    }
+
+    // runs fn, which waits on another stage, and leaves its time out of
+    // whatever time() is counting on this thread.
+    template <typename TFn>
+    static void idle(TFn &&fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        _idle += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // prints "<label>: wall ..., busy ..." to stdout.
+    void print(const std::string &label) const;
+
+private:
+    std::chrono::steady_clock::time_point _start;
+    std::vector<double> _busy;
+
+    static thread_local double _idle;
+};
+
+// calls fn on every item of batches, one loop per worker of clock. the
+// loops take batches off a shared counter, so they start strictly in
+// order, unlike tasks queued on the pool.
+template <typename T, typename TFn>
+void run_batches(
+    ThreadPool &pool, const std::vector<std::vector<T>> &batches,
+    WorkerClock &clock, const TFn &fn
+) {
+    std::atomic<size_t> next = 0;
+    TaskGroup group(pool);
+    for (int k = 0; k < clock.size(); k++) {
+        group.run([&, k] {
+            for (size_t i; (i = next++) < batches.size(); ) {
+                clock.time(k, [&] {
+                    for (auto &item : batches[i]) {
+                        fn(item);
+                    }
+                });
+            }
+        });
+    }
+
+    group.wait();
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+#include "dict.hpp"
+#include "index.hpp"
+
+
+namespace core {
+
+// band half-width added on top of the seed spread and the expected indel drift.
+constexpr int MIN_BAND_WIDTH = 32;
+
+// how locate_run() aligns a run against the window from fuzzy_locate.
+struct RunAlignOptions {
+    // within a band around the diagonal of the seeds only.
+    bool banded = false;
+
+    // expected error rate of the runs, which sets the band width.
+    double band_error = 0.25;
+};
+
+// where locate puts a run. ref is the id of the reference, left and
+// right are 1-indexed and inclusive.
+struct Placement {
+    int ref;
+    int left, right;
+    int loss;
+    bool reversed;
+    Index::SeedStats seeds;
+};
+
+// fuzzy_locate followed by a local alignment against the window it
+// found. reference k of index is refs[base + k], which has to be stored
+// the same way as t.
+template <Sequence TSeq>
+auto locate_run(
+    const Index &index, const LocateOptions &options, const RunAlignOptions &align,
+    Dict &refs, int base, const TSeq &t, AlignWorkspace &workspace
+) -> Placement;
+
+// breakpoints of a run, as found by dump. x is a position in the
+// reference and y one in the run, both 0 when not found. distances are
+// those from each breakpoint to the other or to the end of the run.
+struct Breakpoints {
+    int front_x = 0, front_y = 0, front_distance = 0;
+    int back_x = 0, back_y = 0, back_distance = 0;
+    double inv_match_rate = -1;
+};
+
+// where the run placed on ref by p stops matching it at either end. the
+// line dump prints for it is appended to log.
+auto find_breakpoints(DictEntry &ref, DictEntry &run, const Placement &p, std::string &log) -> Breakpoints;
+
+}
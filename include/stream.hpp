@@ -0,0 +1,39 @@
+#pragma once
+
+#include <thread>
+#include <utility>
+#include <optional>
+
+#include "dict.hpp"
+#include "queue.hpp"
+
+
+namespace core {
+
+// FASTA records read ahead by a background thread. at most capacity
+// records wait in memory, so the reader only runs as far ahead of the
+// consumers as that.
+class ReadStream {
+public:
+    explicit ReadStream(size_t capacity) : _queue(capacity) {}
+    ~ReadStream();
+
+    ReadStream(const ReadStream &) = delete;
+    auto operator=(const ReadStream &) = delete;
+
+    // starts the reader thread. false if the file can not be opened, and
+    // the stream is then empty.
+    auto open(const std::string &path, bool packed = false) -> bool;
+
+    // blocks until a record is available. safe to call from several
+    // threads. nullopt at the end of the file. id is set to the number
+    // of records before it in the file.
+    auto next(size_t *id = nullptr) -> std::optional<DictEntry>;
+
+private:
+    FastaReader _reader;
+    BoundedQueue<std::pair<size_t, DictEntry>> _queue;
+    std::thread _thread;
+};
+
+}
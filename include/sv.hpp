@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+
+#include <memory>
+#include <string>
+
+#include "dict.hpp"
+#include "stages.hpp"
+
+
+namespace core {
+
+// the structural variants suggested by the breakpoints of the runs, as
+// reported by analyze. runs have to be in the orientation of their
+// references, i.e. complemented where locate found them reversed, and
+// their index built.
+class SVCaller {
+public:
+    SVCaller(Dict &refs, Dict &runs);
+    ~SVCaller();
+
+    SVCaller(const SVCaller &) = delete;
+    auto operator=(const SVCaller &) = delete;
+
+    void add(const std::string &run, const std::string &ref, const Breakpoints &b);
+
+    // writes a "<type> <reference> <left> <right>" line for every
+    // variant, or "TRA" with two of them, to out.
+    void call(FILE *out);
+
+private:
+    struct Graph;
+    std::unique_ptr<Graph> _graph;
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdio>
+
+#include <map>
+#include <future>
+#include <string>
+#include <thread>
+#include <functional>
+
+#include "common.hpp"
+#include "queue.hpp"
+
+
+namespace core {
+
+// appends printf-style formatted text to buffer.
+void appendf(std::string &buffer, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// text written by many threads and put out by a single output thread.
+// workers format whole records into their own strings and hand them
+// over, so they never wait on the lock of a FILE.
+//
+// records are numbered from 0. when ordered, they are put out in the
+// order of their numbers instead of as they come in, and every number
+// has to be written, with an empty record for nothing.
+class RecordWriter {
+public:
+    explicit RecordWriter(size_t capacity) : _queue(capacity) {}
+    ~RecordWriter();
+
+    RecordWriter(const RecordWriter &) = delete;
+    auto operator=(const RecordWriter &) = delete;
+
+    // writes to fp, which is not closed afterwards.
+    void open(FILE *fp, bool ordered = false);
+
+    // writes to a new file at path. false if it can not be created.
+    auto open(const std::string &path, bool ordered = false) -> bool;
+
+    // hands every non-empty record to sink on the output thread, in
+    // place of writing it to a file.
+    void open(std::function<void(const std::string &)> sink, bool ordered = false);
+
+    // safe to call from several threads.
+    void write(u64 id, std::string record);
+
+    // returns once every record written so far is in the file. records
+    // are numbered from 0 again afterwards.
+    void flush();
+
+    // flushes and stops the output thread. false if a write to the
+    // file failed.
+    auto close() -> bool;
+
+private:
+    struct Item {
+        u64 id;
+        std::string record;
+        std::promise<void> *flushed = nullptr;
+    };
+
+    FILE *_fp = nullptr;
+    std::function<void(const std::string &)> _sink;
+    bool _owned = false;
+    bool _ordered = false;
+    bool _failed = false;
+    BoundedQueue<Item> _queue;
+    std::thread _thread;
+
+    void _start(FILE *fp, bool owned, bool ordered);
+    void _run();
+};
+
+}
@@ -32,6 +32,7 @@ int main() {
     char ref_path[1024] = "../data/sample/ref.fasta";
     char runs_path[1024] = "../data/sample/long.fasta";
     char bed_path[1024] = "../data/sample/sv.bed";
+    char index_dir[1024] = "";
     core::Dict ref, runs;
     int run_id = 0;
     std::mutex lock;
@@ -56,11 +57,13 @@ int main() {
 
     auto load_files = [&] {
         puts(ref_path);
-        ref.load_file(ref_path);
+        if (!ref.load_file(ref_path))
+            fprintf(stderr, "failed to load \"%s\".\n", ref_path);
         ref.sort_by_name();
 
         puts(runs_path);
-        runs.load_file(runs_path);
+        if (!runs.load_file(runs_path))
+            fprintf(stderr, "failed to load \"%s\".\n", runs_path);
 
         sv.clear();
         sv.resize(ref.size());
@@ -101,10 +104,22 @@ int main() {
         }
         indexes.clear();
 
-        for (auto &e : ref) {
+        // images are named as in locate -x, so both can share a directory.
+        for (int k = 0; k < ref.size(); k++) {
+            auto &e = ref[k];
             auto i = new core::Index;
-            i->append(e.sequence);
-            i->build();
+            std::string image;
+            if (index_dir[0])
+                image = std::string(index_dir) + "/" + core::reference_id(k + 1) + ".idx";
+
+            core::TextFingerprint text;
+            text.append(core::BioSeq(e.sequence));
+            if (image.empty() || !i->load(image, text)) {
+                i->append(e.sequence);
+                i->build();
+                if (!image.empty() && !i->save(image))
+                    fprintf(stderr, "failed to save index to \"%s\".\n", image.data());
+            }
             indexes.push_back(i);
         }
     };
@@ -298,6 +313,11 @@ int main() {
         ImGui::SameLine();
         ImGui::InputText("sv.bed", bed_path, 1024);
 
+        if (ImGui::Button("Clear##4"))
+            index_dir[0] = 0;
+        ImGui::SameLine();
+        ImGui::InputText("index dir", index_dir, 1024);
+
         if (ImGui::Button("Load"))
             load_files();
 
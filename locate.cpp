@@ -1,100 +1,406 @@
-#include <sstream>
+#include <atomic>
+#include <numeric>
 
 #include "CLI11.hpp"
 
 #include "core.hpp"
+#include "schedule.hpp"
 #include "rash/pool.hpp"
 
 
-auto get_id(int i) -> std::string {
-    std::stringstream buffer;
-    buffer << 'S' << i;
-    return buffer.str();
+// k of the minimizer table, which has to match the seeds of fuzzy_locate.
+constexpr int MINIMIZER_K = 20;
+
+// runs read ahead per worker with --stream.
+constexpr int STREAM_RUNS_PER_WORKER = 4;
+
+// runs are batched into one task until their estimated cost, in cells of
+// the alignment matrix, reaches this.
+constexpr double MIN_BATCH_COST = 1 << 20;
+
+// records waiting for the output threads.
+constexpr int OUTPUT_QUEUE_SIZE = 1024;
+
+// loads the index image from `image` if it was saved from the same text,
+// otherwise builds the index and saves the image when `image` is not
+// empty. `fill` appends the text to an Index or a TextFingerprint.
+template <typename TFillFn>
+void prepare_index(
+    core::Index &index, ThreadPool &pool,
+    const std::string &image, const std::string &label,
+    const TFillFn &fill
+) {
+    if (!image.empty()) {
+        core::TextFingerprint text;
+        fill(text);
+        if (index.load(image, text)) {
+            printf("index loaded from \"%s\".\n", image.data());
+            return;
+        }
+    }
+
+    fill(index);
+    index.build(&pool);
+    printf("index built for %s.\n", label.data());
+
+    if (!image.empty() && !index.save(image))
+        printf("warn: failed to save index to \"%s\".\n", image.data());
 }
 
 int main(int argc, char *argv[]) {
     int n_workers = 1;
-    std::string ref_path, runs_path, target;
+    bool shared = false;
+    bool banded = false;
+    double band_error = 0.25;
+    bool astar_only = false;
+    bool packed = false;
+    bool stream = false;
+    bool ordered = false;
+    bool binary = false;
+    int minimizer_window = 0;
+    int max_occurrence = 64;
+    std::string ref_path, runs_path, target, index_dir, output_path;
 
     CLI::App args;
     args.add_option("-r", ref_path)->required();
     args.add_option("-l", runs_path)->required();
     args.add_option("-j", n_workers);
     args.add_option("-t", target);
+    args.add_option("-x,--index-dir", index_dir, "directory of cached index images");
+    args.add_flag("-s,--shared", shared, "one index over all references; runs need no S<i>_ prefix");
+    args.add_flag("-b,--banded", banded, "align within a band around the diagonal from fuzzy_locate");
+    args.add_option("--band-error", band_error, "expected error rate of the runs, which sets the band width");
+    args.add_flag("--astar-only", astar_only, "run A* on every seed, without the exact lookup first");
+    args.add_option("-m,--minimizers", minimizer_window, "seed at (w, 20)-minimizers with this w, 0 to disable");
+    args.add_option("--max-occurrence", max_occurrence, "drop reference minimizers occurring more often");
+    args.add_flag("--packed", packed, "keep references and runs 2-bit packed in memory");
+    args.add_flag("--stream", stream, "read runs while locating instead of loading them all first");
+    args.add_option("-o,--output", output_path, "file of the results, stderr by default");
+    args.add_flag("--ordered", ordered, "write the results of every reference in the order of the runs file");
+    args.add_flag("--binary", binary, "write the results to -o in the binary record format");
     CLI11_PARSE(args, argc, argv);
 
+    if (binary && output_path.empty()) {
+        fprintf(stderr, "--binary needs an output file.\n");
+        return -1;
+    }
+
+    core::LocateOptions options;
+    options.exact_seeds = !astar_only;
+
+    // returns options seeding through `table` when minimizers are enabled.
+    auto with_table = [&](core::MinimizerTable &table, auto fill) {
+        auto result = options;
+        if (minimizer_window > 0) {
+            fill(table);
+            table.build();
+            printf("minimizer table: %zu positions.\n", table.size());
+            result.minimizers = &table;
+        }
+
+        return result;
+    };
+
+    // workers hand their lines to the writers instead of printing them.
+    // the record file is completed after the writers are done with it.
+    core::RecordFileWriter records;
+    core::RecordWriter log(OUTPUT_QUEUE_SIZE), results(OUTPUT_QUEUE_SIZE);
+    log.open(stdout, ordered);
+    if (binary && records.open<core::LocateRecord>(output_path)) {
+        results.open([&records](const std::string &s) {
+            records.write_encoded(s);
+        }, ordered);
+    } else if (output_path.empty())
+        results.open(stderr, ordered);
+    else if (binary || !results.open(output_path, ordered)) {
+        fprintf(stderr, "failed to create \"%s\".\n", output_path.data());
+        return -1;
+    }
+
+    // the results are complete only once the writers are closed, the
+    // record file after the writer feeding it.
+    auto close_output = [&]() -> bool {
+        bool ok = results.close();
+        if (binary)
+            ok = records.close() && ok;
+
+        if (!ok)
+            fprintf(stderr, "failed to write \"%s\".\n", output_path.data());
+        return ok;
+    };
+
+    ThreadPool pool(n_workers);
+
     core::Dict ref, runs;
-    ref.load_file(ref_path);
+    if (!ref.load_file(ref_path, packed, &pool)) {
+        fprintf(stderr, "failed to load \"%s\".\n", ref_path.data());
+        return -1;
+    }
     ref.sort_by_name();
     printf("loaded: \"%s\".\n", ref_path.data());
-    runs.load_file(runs_path);
-    printf("loaded: \"%s\".\n", runs_path.data());
+    // a single run is fetched through the index of the file.
+    if (!target.empty()) {
+        stream = false;
+        if (!runs.load_records(runs_path, {target}, packed)) {
+            fprintf(stderr, "failed to load %s from \"%s\".\n", target.data(), runs_path.data());
+            return -1;
+        }
+        printf("loaded: %s from \"%s\".\n", target.data(), runs_path.data());
+    } else if (!stream) {
+        if (!runs.load_file(runs_path, packed, &pool)) {
+            fprintf(stderr, "failed to load \"%s\".\n", runs_path.data());
+            return -1;
+        }
+        printf("loaded: \"%s\".\n", runs_path.data());
+    }
 
-    ThreadPool pool(n_workers);
+    if (packed) {
+        size_t n_bases = 0, n_bytes = 0;
+        for (auto dict : {&ref, &runs}) {
+            for (auto &e : *dict) {
+                n_bases += e.packed.size();
+                n_bytes += e.packed.memory();
+            }
+        }
 
-    for (int i = 0; i < ref.size(); i++) {
-        auto idx = get_id(i + 1);
-        printf("locating shotguns %s_*...\n", idx.data());
+        printf("packed: %zu bases in %zu bytes.\n", n_bases, n_bytes);
+    }
 
-        core::Index index;
-        index.append(ref[i].sequence);
-        index.build();
-        printf("index built for %s.\n", ref[i].name.data());
-
-        std::vector<std::future<void>> futures;
-        for (int j = 0; j < runs.size(); j++) {
-            if (!core::startswith(runs[j].name, idx))
-                continue;
-            if (!target.empty() && runs[j].name != target)
-                continue;
-
-            auto future = pool.run([&ref, &runs, &index, i, j] {
-                auto &t = runs[j].sequence;
-                auto location = index.fuzzy_locate(t);
-
-                auto s = core::BioSeq(ref[i].sequence, location.left, location.right + 1);
-
-                core::Alignment result;
-                if (location.reversed) {
-                    auto q = core::watson_crick_complement(t);
-                    result = core::local_align(s, q);
-                } else
-                    result = core::local_align(s, t);
-
-                int left = result.range1.begin + location.left - 1;
-                int right = result.range1.end - 1 + location.left - 1;
-                int length = result.range1.end - result.range1.begin;
-                double match_rate = double(t.size() - result.loss) / t.size();
-
-                printf(
-                    "%s @%s: [%d, %d], loss=%d (%.3lf%%), ratio=%.3lf, rev=%d\n",
-                    runs[j].name.data(),
-                    ref[i].name.data(),
-                    left, right,
-                    result.loss,
-                    match_rate * 100,
-                    double(length) / runs[j].sequence.size(),
-                    location.reversed
-                );
-                fprintf(stderr,
-                    "%s %s %d %d %d %d\n",
-                    runs[j].name.data(),
-                    ref[i].name.data(),
-                    left, right,
-                    result.loss,
-                    location.reversed
-                );
+    // calls `fn` with a view of the sequence of `e`, as it is stored.
+    auto with_sequence = [packed](core::DictEntry &e, auto &&fn) {
+        if (packed)
+            return fn(e.packed.view());
+        return fn(core::BioSeq(e.sequence));
+    };
+
+    // images are keyed by the position of the reference in the sorted
+    // dictionary, since record names may contain '/' or spaces.
+    auto image_path = [&index_dir](const std::string &key) -> std::string {
+        return index_dir.empty() ? "" : index_dir + "/" + key + ".idx";
+    };
+
+    std::atomic<int64_t> n_table = 0, n_repetitive = 0;
+    std::atomic<int64_t> n_exact = 0, n_aligned = 0, n_state_visited = 0;
+    auto print_seed_stats = [&] {
+        if (minimizer_window > 0) {
+            printf(
+                "minimizers: %ld found in the table, %ld repetitive.\n",
+                n_table.load(), n_repetitive.load()
+            );
+        }
+
+        printf(
+            "seeds: %ld exact, %ld aligned, %ld states visited by A*.\n",
+            n_exact.load(), n_aligned.load(), n_state_visited.load()
+        );
+    };
+
+    core::RunAlignOptions align_options;
+    align_options.banded = banded;
+    align_options.band_error = band_error;
+
+    // `base` is the id of the first reference covered by `index`, `t` a
+    // view of `run` and `id` the number of its output records.
+    auto locate_run = [&](
+        const core::Index &index, const core::LocateOptions &options,
+        int base, const core::DictEntry &run, const auto &t, core::u64 id
+    ) {
+        thread_local core::AlignWorkspace workspace;
+        auto p = core::locate_run(index, options, align_options, ref, base, t, workspace);
+        n_table += p.seeds.n_table;
+        n_repetitive += p.seeds.n_repetitive;
+        n_exact += p.seeds.n_exact;
+        n_aligned += p.seeds.n_aligned;
+        n_state_visited += p.seeds.n_state_visited;
+
+        int length = p.right - p.left + 1;
+        double match_rate = double(t.size() - p.loss) / t.size();
+
+        std::string line, record;
+        core::appendf(line,
+            "%s @%s: [%d, %d], loss=%d (%.3lf%%), ratio=%.3lf, rev=%d\n",
+            run.name.data(),
+            ref[p.ref].name.data(),
+            p.left, p.right,
+            p.loss,
+            match_rate * 100,
+            double(length) / t.size(),
+            p.reversed
+        );
+        if (binary) {
+            core::LocateRecord r = {0, 0, p.left, p.right, p.loss, p.reversed};
+            record = core::encode_record(run.name, ref[p.ref].name, r);
+        } else {
+            core::appendf(record,
+                "%s %s %d %d %d %d\n",
+                run.name.data(),
+                ref[p.ref].name.data(),
+                p.left, p.right,
+                p.loss,
+                p.reversed
+            );
+        }
+
+        log.write(id, std::move(line));
+        results.write(id, std::move(record));
+    };
+
+    // `base` is the id of the first reference covered by `index`.
+    auto locate = [&](
+        const core::Index &index, const core::LocateOptions &options,
+        int base, core::DictEntry &run, core::u64 id
+    ) {
+        with_sequence(run, [&](const auto &t) {
+            locate_run(index, options, base, run, t, id);
+        });
+    };
+
+    // a run is aligned against a window of about its own length, or
+    // within a band with -b.
+    auto estimate_cost = [&](core::DictEntry *run) -> double {
+        double n = with_sequence(*run, [](const auto &t) {
+            return t.size();
+        });
+
+        return banded ? n * (core::MIN_BAND_WIDTH + band_error * n / 2) : n * n;
+    };
+
+    // calls `fn(run, id)` on the pool for every run whose name passes
+    // `filter`, the longest first so that no worker is left alone with a
+    // long run at the end, and prints the busy time of the workers after
+    // `label`. with --stream, the workers take the runs from a stream of
+    // the file in file order instead, which holds a few runs per worker
+    // at a time. ids count the runs in file order.
+    auto for_each_run = [&](const std::string &label, auto &&filter, auto &&fn) -> bool {
+        core::WorkerClock clock(pool.size());
+
+        if (!stream) {
+            std::vector<core::DictEntry *> selected;
+            for (auto &run : runs) {
+                if (filter(run.name))
+                    selected.push_back(&run);
+            }
+
+            std::vector<core::u64> ids(selected.size());
+            std::iota(ids.begin(), ids.end(), 0);
+            auto batches = core::plan_batches(ids, [&](core::u64 id) {
+                return estimate_cost(selected[id]);
+            }, MIN_BATCH_COST);
+
+            core::run_batches(pool, batches, clock, [&](core::u64 id) {
+                fn(*selected[id], id);
             });
 
-            futures.push_back(std::move(future));
+            log.flush();
+            results.flush();
+            clock.print(label);
+            return true;
         }
 
-        for (auto &f : futures) {
-            f.get();
+        core::ReadStream reads(STREAM_RUNS_PER_WORKER * pool.size());
+        if (!reads.open(runs_path, packed)) {
+            fprintf(stderr, "failed to open \"%s\".\n", runs_path.data());
+            return false;
+        }
+
+        TaskGroup group(pool);
+        for (int k = 0; k < pool.size(); k++) {
+            group.run([&, k] {
+                size_t id;
+                while (auto run = reads.next(&id)) {
+                    if (filter(run->name)) {
+                        clock.time(k, [&] {
+                            fn(*run, id);
+                        });
+                    } else {
+                        log.write(id, "");
+                        results.write(id, "");
+                    }
+                }
+            });
         }
 
+        group.wait();
+        log.flush();
+        results.flush();
+        clock.print(label);
+        return true;
+    };
+
+    if (shared) {
+        core::Index index;
+        auto label = std::to_string(ref.size()) + " references";
+        prepare_index(index, pool, image_path("shared"), label, [&](auto &text) {
+            for (auto &e : ref) {
+                with_sequence(e, [&](const auto &s) {
+                    text.append_reference(s);
+                });
+            }
+        });
+
+        if (index.n_references() != ref.size()) {
+            fprintf(stderr, "index covers %d references, expected %zu.\n", index.n_references(), ref.size());
+            return -1;
+        }
+
+        core::MinimizerTable table(minimizer_window, MINIMIZER_K, max_occurrence);
+        auto shared_options = with_table(table, [&](core::MinimizerTable &table) {
+            for (auto &e : ref) {
+                with_sequence(e, [&](const auto &s) {
+                    table.append_reference(s);
+                });
+            }
+        });
+
+        bool ok = for_each_run("shared", [&](const std::string &name) {
+            return target.empty() || name == target;
+        }, [&](core::DictEntry &run, core::u64 id) {
+            locate(index, shared_options, 0, run, id);
+        });
+
+        if (!ok || !close_output())
+            return -1;
+
+        print_seed_stats();
+        printf("all completed.\n");
+        return 0;
+    }
+
+    for (int i = 0; i < ref.size(); i++) {
+        auto idx = core::reference_id(i + 1);
+        auto prefix = core::run_prefix(i + 1);
+        printf("locating shotguns %s*...\n", prefix.data());
+
+        core::Index index;
+        prepare_index(index, pool, image_path(idx), ref[i].name, [&](auto &text) {
+            with_sequence(ref[i], [&](const auto &s) {
+                text.append(s);
+            });
+        });
+
+        core::MinimizerTable table(minimizer_window, MINIMIZER_K, max_occurrence);
+        auto ref_options = with_table(table, [&](core::MinimizerTable &table) {
+            with_sequence(ref[i], [&](const auto &s) {
+                table.append(s);
+            });
+        });
+
+        bool ok = for_each_run(prefix + "*", [&](const std::string &name) {
+            return core::startswith(name, prefix) && (target.empty() || name == target);
+        }, [&](core::DictEntry &run, core::u64 id) {
+            locate(index, ref_options, i, run, id);
+        });
+
+        if (!ok)
+            return -1;
+
         printf("%s_*: %s completed.\n", idx.data(), ref[i].name.data());
     }
 
+    if (!close_output())
+        return -1;
+
+    print_seed_stats();
+
     return 0;
 }
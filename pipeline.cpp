@@ -0,0 +1,191 @@
+#include <numeric>
+#include <optional>
+
+#include "CLI11.hpp"
+
+#include "core.hpp"
+#include "schedule.hpp"
+#include "rash/pool.hpp"
+
+
+// runs are batched into one task until their estimated cost, in cells of
+// the alignment matrix, reaches this.
+constexpr double MIN_BATCH_COST = 1 << 20;
+
+// located runs waiting for the dump stage, per dump thread.
+constexpr int QUEUED_RUNS_PER_WORKER = 4;
+
+// a run located by the first stage, for the second.
+struct Located {
+    int k;
+    core::Placement p;
+};
+
+// locate, dump and analyze in one process. the references, the runs and
+// the index stay in memory, and the breakpoints go to the analysis
+// without a file in between.
+//
+// locate and dump are two stages with their own threads, joined by a
+// bounded queue: a run is dumped as soon as it is located, and the dump
+// stage keeps working while the next index is built. when dumping falls
+// behind, the full queue holds the locate stage back.
+int main(int argc, char *argv[]) {
+    int n_workers = 1;
+    int n_locate_workers = 0, n_dump_workers = 0;
+    bool shared = false;
+    bool banded = false;
+    double band_error = 0.25;
+    double max_rate = 0.84;
+    std::string ref_path, runs_path;
+
+    CLI::App args;
+    args.add_option("-r", ref_path)->required();
+    args.add_option("-l", runs_path)->required();
+    args.add_option("-j", n_workers);
+    args.add_option("--locate-threads", n_locate_workers, "threads locating runs and building indices, -j by default");
+    args.add_option("--dump-threads", n_dump_workers, "threads dumping located runs, -j by default");
+    args.add_option("-m", max_rate, "dump runs located with at most this match rate");
+    args.add_flag("-s,--shared", shared, "one index over all references; runs need no S<i>_ prefix");
+    args.add_flag("-b,--banded", banded, "align within a band around the diagonal from fuzzy_locate");
+    args.add_option("--band-error", band_error, "expected error rate of the runs, which sets the band width");
+    CLI11_PARSE(args, argc, argv);
+
+    ThreadPool pool(n_locate_workers > 0 ? n_locate_workers : n_workers);
+    ThreadPool dump_pool(n_dump_workers > 0 ? n_dump_workers : n_workers);
+
+    // refs keep the order of the file, which is the order of the output.
+    core::Dict refs, runs;
+    if (!refs.load_file(ref_path, false, &pool)) {
+        fprintf(stderr, "failed to load \"%s\".\n", ref_path.data());
+        return -1;
+    }
+    printf("loaded: \"%s\".\n", ref_path.data());
+
+    if (!runs.load_file(runs_path, false, &pool)) {
+        fprintf(stderr, "failed to load \"%s\".\n", runs_path.data());
+        return -1;
+    }
+    runs.build_index();
+    printf("loaded: \"%s\".\n", runs_path.data());
+
+    core::LocateOptions options;
+    core::RunAlignOptions align_options;
+    align_options.banded = banded;
+    align_options.band_error = band_error;
+
+    std::vector<std::optional<core::Placement>> placements(runs.size());
+    std::vector<std::optional<core::Breakpoints>> breakpoints(runs.size());
+
+    core::BoundedQueue<Located> located(QUEUED_RUNS_PER_WORKER * dump_pool.size());
+    core::WorkerClock locate_clock(pool.size()), dump_clock(dump_pool.size());
+
+    // reversed runs are complemented once dumped, as analyze expects them.
+    auto dump = [&](int k, const core::Placement &p) {
+        auto &run = runs[k];
+        auto rate = 1.0 - double(p.loss) / run.sequence.size();
+        if (rate <= max_rate) {
+            std::string log;
+            breakpoints[k] = core::find_breakpoints(refs[p.ref], run, p, log);
+        }
+
+        if (p.reversed)
+            run.sequence = core::watson_crick_complement(run.sequence);
+    };
+
+    TaskGroup dump_stage(dump_pool);
+    for (int w = 0; w < dump_pool.size(); w++) {
+        dump_stage.run([&, w] {
+            while (auto item = located.pop()) {
+                dump_clock.time(w, [&] {
+                    dump(item->k, item->p);
+                });
+            }
+        });
+    }
+
+    auto locate = [&](const core::Index &index, int base, int k) {
+        thread_local core::AlignWorkspace workspace;
+        auto p = core::locate_run(index, options, align_options, refs, base, core::BioSeq(runs[k].sequence), workspace);
+        placements[k] = p;
+
+        core::WorkerClock::idle([&] {
+            located.push({k, p});
+        });
+    };
+
+    // runs whose name passes `filter`, the longest first.
+    auto run_pass = [&](const std::string &label, const core::Index &index, int base, auto &&filter) {
+        std::vector<int> selected;
+        for (int k = 0; k < runs.size(); k++) {
+            if (filter(runs[k].name))
+                selected.push_back(k);
+        }
+
+        auto batches = core::plan_batches(selected, [&](int k) {
+            double n = runs[k].sequence.size();
+            return n * n;
+        }, MIN_BATCH_COST);
+
+        core::run_batches(pool, batches, locate_clock, [&](int k) {
+            locate(index, base, k);
+        });
+
+        printf("%s: %zu runs located.\n", label.data(), selected.size());
+    };
+
+    if (shared) {
+        core::Index index;
+        for (auto &e : refs) {
+            index.append_reference(core::BioSeq(e.sequence));
+        }
+        index.build(&pool);
+        printf("index built for %zu references.\n", refs.size());
+
+        run_pass("shared", index, 0, [](const std::string &) {
+            return true;
+        });
+    } else {
+        // S<i> is the i-th reference by name, as in locate.
+        std::vector<int> order(refs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int u, int v) {
+            return refs[u].name < refs[v].name;
+        });
+
+        for (int i = 0; i < order.size(); i++) {
+            auto &ref = refs[order[i]];
+            auto prefix = core::run_prefix(i + 1);
+
+            core::Index index;
+            index.append(core::BioSeq(ref.sequence));
+            index.build(&pool);
+            printf("index built for %s.\n", ref.name.data());
+
+            run_pass(prefix + "*", index, order[i], [&](const std::string &name) {
+                return core::startswith(name, prefix);
+            });
+        }
+    }
+
+    located.close();
+    dump_stage.wait();
+    locate_clock.print("locate");
+    dump_clock.print("dump");
+
+    // added in the order of the runs file, so that the output does not
+    // depend on the threads.
+    core::SVCaller caller(refs, runs);
+    int n_located = 0, n_dumped = 0;
+    for (int k = 0; k < runs.size(); k++) {
+        n_located += placements[k].has_value();
+        if (breakpoints[k]) {
+            caller.add(runs[k].name, refs[placements[k]->ref].name, *breakpoints[k]);
+            n_dumped++;
+        }
+    }
+
+    printf("%d runs located, %d dumped.\n", n_located, n_dumped);
+    caller.call(stderr);
+
+    return 0;
+}
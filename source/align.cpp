@@ -1,8 +1,7 @@
 #include <cstdio>
+#include <cstdint>
 
-#include <queue>
-
-#include "tsl/robin_map.h"
+#include <algorithm>
 
 #include "index.hpp"
 
@@ -16,6 +15,8 @@ constexpr int CHAR_COST = 1;
 constexpr int FULL_COST = MISS_COST + CHAR_COST;
 constexpr int H_VALUE = 5;
 
+constexpr int BITWISE_MIN_LENGTH = 16;
+
 struct Key {
     int x = 1, y = 0;
 
@@ -43,24 +44,447 @@ struct Heuristic {
     }
 };
 
+// open list of Index::align(): a binary heap on Heuristic, popping in the
+// same order as std::priority_queue would.
+class HeapQueue {
+public:
+    void clear(int n) {
+        _heap.clear();
+        _cmp = {n};
+    }
+
+    auto empty() const -> bool {
+        return _heap.empty();
+    }
+
+    auto size() const -> size_t {
+        return _heap.size();
+    }
+
+    void push(const State &s) {
+        _heap.push_back(s);
+        std::push_heap(_heap.begin(), _heap.end(), _cmp);
+    }
+
+    auto pop() -> State {
+        std::pop_heap(_heap.begin(), _heap.end(), _cmp);
+        auto s = _heap.back();
+        _heap.pop_back();
+        return s;
+    }
+
+private:
+    std::vector<State> _heap;
+    Heuristic _cmp{0};
+};
+
+// open list of Index::align() with one bucket per estimate. estimates are
+// small integers, but not monotone: a matched character lowers the
+// estimate by H_VALUE - CHAR_COST, so the cursor moves back on such
+// pushes. ties are popped last-in first-out, which may pick a different
+// token of the same loss than HeapQueue.
+class BucketQueue {
+public:
+    void clear(int n) {
+        for (int k = _cursor; k <= _top; k++) {
+            _buckets[k].clear();
+        }
+
+        _h = {n};
+        _size = 0;
+        _cursor = INF;
+        _top = -1;
+    }
+
+    auto empty() const -> bool {
+        return _size == 0;
+    }
+
+    auto size() const -> size_t {
+        return _size;
+    }
+
+    void push(const State &s) {
+        int k = _h.estimate(s);
+        if (k >= int(_buckets.size()))
+            _buckets.resize(k + 1);
+
+        _buckets[k].push_back(s);
+        _size++;
+        _cursor = std::min(_cursor, k);
+        _top = std::max(_top, k);
+    }
+
+    auto pop() -> State {
+        while (_buckets[_cursor].empty()) {
+            _cursor++;
+        }
+
+        auto &bucket = _buckets[_cursor];
+        auto s = bucket.back();
+        bucket.pop_back();
+        _size--;
+        return s;
+    }
+
+private:
+    std::vector<std::vector<State>> _buckets;
+    Heuristic _h{0};
+    size_t _size = 0;
+    int _cursor = 0, _top = -1;
+};
+
+#ifdef TASK2_BUCKET_QUEUE
+using OpenQueue = BucketQueue;
+#else
+using OpenQueue = HeapQueue;
+#endif
+
+// open addressing table from Key to the lowest cost seen so far. slots
+// carry the generation they were written in, so clear() only bumps the
+// generation and the storage is reused from call to call.
+class CostTable {
+public:
+    CostTable() {
+        _slots.resize(1 << _bits);
+    }
+
+    void clear() {
+        _size = 0;
+        if (++_generation == 0) {
+            for (auto &slot : _slots) {
+                slot.generation = 0;
+            }
+            _generation = 1;
+        }
+    }
+
+    auto size() const -> int {
+        return _size;
+    }
+
+    // cost of key, inserted as INF if absent. the reference is valid
+    // until the next insertion.
+    auto operator[](const Key &key) -> int & {
+        if (2 * (_size + 1) > int(_slots.size()))
+            _grow();
+
+        size_t mask = _slots.size() - 1;
+        for (size_t p = _hash(key); ; p = (p + 1) & mask) {
+            auto &slot = _slots[p];
+            if (slot.generation != _generation) {
+                slot = {key, INF, _generation};
+                _size++;
+                return slot.cost;
+            }
+
+            if (slot.key == key)
+                return slot.cost;
+        }
+    }
+
+private:
+    struct Slot {
+        Key key;
+        int cost;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Slot> _slots;
+    uint32_t _generation = 1;
+    int _size = 0;
+    int _bits = 10;
+
+    // fibonacci hashing: the top bits of the product mix all of x and y.
+    auto _hash(const Key &key) const -> size_t {
+        uint64_t z = (uint64_t(uint32_t(key.x)) << 32) | uint32_t(key.y);
+        return (z * 0x9e3779b97f4a7c15) >> (64 - _bits);
+    }
+
+    void _grow() {
+        std::vector<Slot> slots;
+        slots.swap(_slots);
+        _bits++;
+        _slots.resize(1 << _bits);
+
+        size_t mask = _slots.size() - 1;
+        for (auto &slot : slots) {
+            if (slot.generation != _generation)
+                continue;
+
+            size_t p = _hash(slot.key);
+            while (_slots[p].generation == _generation) {
+                p = (p + 1) & mask;
+            }
+            _slots[p] = slot;
+        }
+    }
+};
+
 template <typename T>
 void update(T &dest, const T &value) {
     if (value < dest)
         dest = value;
 }
 
+auto make_local_alignment(int t, int d, int opt_i, int m) -> core::Alignment {
+    core::Alignment result;
+    int len = m + d;
+    result.range1 = {opt_i - len + 1, opt_i + 1};
+    result.range2 = {1, m + 1};
+    result.loss = t;
+
+    return result;
 }
 
-template <>
-struct std::hash<Key> {
-    auto operator()(const Key &z) const -> size_t {
-        return ((z.x << 15) ^ z.y) * 0x19260817;
+// local_align() evaluated along anti-diagonals: every cell of diagonal
+// k = i + j depends only on diagonals k - 1 and k - 2, so W cells are
+// updated at once. cells are indexed by j, s1 is stored reversed so that
+// s1[k - j] is contiguous in j as well. both sequences are read once into
+// plain characters, which are compared W at a time and widened to the
+// lanes only as the match mask. each cell applies the same
+// updates in the same order as the scalar loop, including the (t, |d|)
+// tie-breaking, so the results are identical.
+typedef int Vector4 __attribute__((vector_size(16)));
+typedef int Vector8 __attribute__((vector_size(32)));
+typedef char Chars4 __attribute__((vector_size(4)));
+typedef char Chars8 __attribute__((vector_size(8)));
+
+template <int W>
+struct Lanes {
+    using Vector = std::conditional_t<W == 8, Vector8, Vector4>;
+    using Chars = std::conditional_t<W == 8, Chars8, Chars4>;
+
+    [[gnu::always_inline]] static inline auto load(const int *p) -> Vector {
+        Vector v;
+        __builtin_memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    [[gnu::always_inline]] static inline void store(int *p, const Vector &v) {
+        __builtin_memcpy(p, &v, sizeof(v));
+    }
+
+    // all ones in the lanes where p and q hold the same character.
+    [[gnu::always_inline]] static inline auto equal(const char *p, const char *q) -> Vector {
+        Chars u, v;
+        __builtin_memcpy(&u, p, sizeof(u));
+        __builtin_memcpy(&v, q, sizeof(v));
+        return __builtin_convertvector(u == v, Vector);
     }
+
+    [[gnu::always_inline]] static inline auto abs(const Vector &v) -> Vector {
+        auto sign = v >> 31;
+        return (v ^ sign) - sign;
+    }
+
+    // lexicographic (t, |d|) comparison, as in local_align's Value.
+    [[gnu::always_inline]] static inline auto less(
+        const Vector &t1, const Vector &d1,
+        const Vector &t2, const Vector &d2
+    ) -> Vector {
+        return (t1 < t2) | ((t1 == t2) & (abs(d1) < abs(d2)));
+    }
+
+    [[gnu::always_inline]] static inline auto select(
+        const Vector &mask, const Vector &a, const Vector &b
+    ) -> Vector {
+        return (mask & a) | (~mask & b);
+    }
+};
+
+// cells of local_align's DP with |i - j - diagonal| <= width.
+struct Band {
+    int diagonal, width;
 };
 
+template <int W, bool Banded, typename TSeq1, typename TSeq2>
+[[gnu::always_inline]] inline auto local_align_diagonal(
+    const TSeq1 &s1, const TSeq2 &s2, const Band &band = {}
+) -> core::Alignment {
+    using V = Lanes<W>;
+    using Vector = typename V::Vector;
+
+    int n = s1.size(), m = s2.size();
+
+    // a[x] = s1[n + 1 - x], b[j] = s2[j].
+    std::string a, b;
+    a.resize(n + 1);
+    b.resize(m + 1);
+    for (int i = 1; i <= n; i++) {
+        a[n + 1 - i] = s1[i];
+    }
+    for (int j = 1; j <= m; j++) {
+        b[j] = s2[j];
+    }
+
+    // three diagonals in rotation, t and d separately.
+    std::vector<int> buffer;
+    buffer.resize(6 * (m + 1));
+    int *t[3], *d[3];
+    for (int r = 0; r < 3; r++) {
+        t[r] = buffer.data() + (2 * r) * (m + 1);
+        d[r] = buffer.data() + (2 * r + 1) * (m + 1);
+    }
+
+    // f[i][m] for i = 1..n.
+    struct Cell {
+        int t, d;
+    };
+    std::vector<Cell> last;
+    last.resize(n + 1, {INF, INF});
+
+    t[0][0] = d[0][0] = 0;
+
+    const Vector one = Vector{} + 1;
+    for (int k = 1; k <= n + m; k++) {
+        int *tc = t[k % 3], *dc = d[k % 3];
+        const int *t1 = t[(k + 2) % 3], *d1 = d[(k + 2) % 3];
+        const int *t2 = t[(k + 1) % 3], *d2 = d[(k + 1) % 3];
+        const char *ak = a.data() + n + 1 - k;
+
+        int lo = std::max(1, k - n), hi = std::min(m, k - 1);
+
+        // band on this diagonal: k - 2j in [diagonal - width, diagonal + width].
+        int bl = 0, bh = 0;
+        if constexpr (Banded) {
+            bl = (k - band.diagonal - band.width + 1) >> 1;
+            bh = (k - band.diagonal + band.width) >> 1;
+            lo = std::max(lo, bl);
+            hi = std::min(hi, bh);
+        }
+
+        int j = lo;
+        for ( ; j + W - 1 <= hi; j += W) {
+            auto up_t = V::load(t1 + j) + one;
+            auto up_d = V::load(d1 + j) + one;
+            auto dg_t = V::load(t2 + j - 1);
+            auto dg_d = V::load(d2 + j - 1);
+            auto lf_t = V::load(t1 + j - 1) + one;
+            auto lf_d = V::load(d1 + j - 1) - one;
+
+            auto match = V::equal(ak + j, b.data() + j);
+            auto take = match & V::less(dg_t, dg_d, up_t, up_d);
+            auto vt = V::select(take, dg_t, up_t);
+            auto vd = V::select(take, dg_d, up_d);
+
+            auto take_left = V::less(lf_t, lf_d, vt, vd);
+            V::store(tc + j, V::select(take_left, lf_t, vt));
+            V::store(dc + j, V::select(take_left, lf_d, vd));
+        }
+
+        for ( ; j <= hi; j++) {
+            int vt = t1[j] + 1, vd = d1[j] + 1;
+
+            auto less = [](int t1, int d1, int t2, int d2) {
+                return t1 == t2 ? std::abs(d1) < std::abs(d2) : t1 < t2;
+            };
+
+            if (ak[j] == b[j] && less(t2[j - 1], d2[j - 1], vt, vd)) {
+                vt = t2[j - 1];
+                vd = d2[j - 1];
+            }
+
+            if (less(t1[j - 1] + 1, d1[j - 1] - 1, vt, vd)) {
+                vt = t1[j - 1] + 1;
+                vd = d1[j - 1] - 1;
+            }
+
+            tc[j] = vt;
+            dc[j] = vd;
+        }
+
+        // cells just outside the band are read by the next two diagonals.
+        if constexpr (Banded) {
+            for (int x : {bl - 1, bh + 1}) {
+                if (0 <= x && x <= m)
+                    tc[x] = dc[x] = INF;
+            }
+        }
+
+        // f[k][0] and f[0][k].
+        auto in_band = [bl, bh](int x) {
+            return !Banded || (bl <= x && x <= bh);
+        };
+
+        if (k <= n && in_band(0))
+            tc[0] = dc[0] = 0;
+
+        if (k <= m && in_band(k)) {
+            tc[k] = k;
+            dc[k] = -k;
+        }
+
+        int i = k - m;
+        if (1 <= i && i <= n && in_band(m))
+            last[i] = {tc[m], dc[m]};
+    }
+
+    int opt_t = INF, opt_d = INF, opt_i = 0;
+    for (int i = 1; i <= n; i++) {
+        auto [vt, vd] = last[i];
+        if (vt == opt_t ? std::abs(vd) < std::abs(opt_d) : vt < opt_t) {
+            opt_t = vt;
+            opt_d = vd;
+            opt_i = i;
+        }
+    }
+
+    return make_local_alignment(opt_t, opt_d, opt_i, m);
+}
+
+// the target attributes and cpu builtins exist only on x86.
+#if defined(__x86_64__) || defined(__i386__)
+template <typename TSeq1, typename TSeq2>
+[[gnu::target("avx2")]]
+auto local_align_avx2(const TSeq1 &s1, const TSeq2 &s2) -> core::Alignment {
+    return local_align_diagonal<8, false>(s1, s2);
+}
+
+template <typename TSeq1, typename TSeq2>
+[[gnu::target("sse4.1")]]
+auto local_align_sse41(const TSeq1 &s1, const TSeq2 &s2) -> core::Alignment {
+    return local_align_diagonal<4, false>(s1, s2);
+}
+#else
+// elsewhere the compiler lowers the vectors to what the target has.
+template <typename TSeq1, typename TSeq2>
+auto local_align_generic(const TSeq1 &s1, const TSeq2 &s2) -> core::Alignment {
+    return local_align_diagonal<4, false>(s1, s2);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+template <typename TSeq1, typename TSeq2>
+[[gnu::target("avx2")]]
+auto banded_local_align_avx2(
+    const TSeq1 &s1, const TSeq2 &s2, const Band &band
+) -> core::Alignment {
+    return local_align_diagonal<8, true>(s1, s2, band);
+}
+#endif
+
+template <typename TSeq1, typename TSeq2>
+auto banded_local_align_generic(
+    const TSeq1 &s1, const TSeq2 &s2, const Band &band
+) -> core::Alignment {
+    return local_align_diagonal<4, true>(s1, s2, band);
+}
+}
+
 namespace core {
 
-auto full_align(const BioSeq &s1, const BioSeq &s2) -> int {
+struct AlignWorkspace::Impl {
+    OpenQueue q;
+    CostTable best;
+};
+
+AlignWorkspace::AlignWorkspace() : _impl(std::make_unique<Impl>()) {}
+
+AlignWorkspace::~AlignWorkspace() = default;
+
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _full_align_scalar_impl(const TSeq1 &s1, const TSeq2 &s2) -> int {
     int n = s1.size(), m = s2.size();
     std::vector<int> f;
 
@@ -86,7 +510,89 @@ auto full_align(const BioSeq &s1, const BioSeq &s2) -> int {
     return f[m];
 }
 
-auto local_align(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+// full_align() allows no substitutions, so its distance is n + m - 2 LCS.
+// LCS follows the bit-vector recurrence of Hyyrö (2004), one bit per
+// character of the pattern p, carried across 64-bit words.
+template <Sequence TPattern, Sequence TText>
+static auto _lcs_bitwise(const TPattern &p, const TText &t) -> int {
+    int n = t.size(), m = p.size();
+    int n_words = (m + 63) / 64;
+
+    // slot 0 matches nothing.
+    u8 slot[256] = {0};
+    int n_slots = 1;
+    for (int j = 1; j <= m; j++) {
+        auto &k = slot[static_cast<u8>(p[j])];
+        if (!k)
+            k = n_slots++;
+    }
+
+    std::vector<u64> peq, v;
+    peq.resize(n_slots * n_words);
+    for (int j = 0; j < m; j++) {
+        int k = slot[static_cast<u8>(p[j + 1])];
+        peq[k * n_words + j / 64] |= u64(1) << (j % 64);
+    }
+
+    v.resize(n_words, ~u64(0));
+    for (int i = 1; i <= n; i++) {
+        int k = slot[static_cast<u8>(t[i])];
+        if (!k)
+            continue;
+
+        auto eq = peq.data() + k * n_words;
+        u64 carry = 0;
+        for (int w = 0; w < n_words; w++) {
+            u64 u = v[w] & eq[w];
+            u64 x = v[w] + u;
+            u64 y = x + carry;
+            carry = (x < u) | (y < x);
+            v[w] = y | (v[w] & ~eq[w]);
+        }
+    }
+
+    int lcs = 0;
+    for (int w = 0; w < n_words; w++) {
+        u64 mask = w + 1 < n_words || m % 64 == 0 ? ~u64(0) : (u64(1) << (m % 64)) - 1;
+        lcs += __builtin_popcountll(~v[w] & mask);
+    }
+
+    return lcs;
+}
+
+// the shorter sequence is the pattern.
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _full_align_bitwise_impl(const TSeq1 &s1, const TSeq2 &s2) -> int {
+    int lcs = s1.size() < s2.size() ? _lcs_bitwise(s1, s2) : _lcs_bitwise(s2, s1);
+    return s1.size() + s2.size() - 2 * lcs;
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _full_align_impl(const TSeq1 &s1, const TSeq2 &s2) -> int {
+    if (std::min(s1.size(), s2.size()) < BITWISE_MIN_LENGTH)
+        return _full_align_scalar_impl(s1, s2);
+    return _full_align_bitwise_impl(s1, s2);
+}
+
+auto full_align_scalar(const BioSeq &s1, const BioSeq &s2) -> int {
+    return _full_align_scalar_impl(s1, s2);
+}
+
+auto full_align_bitwise(const BioSeq &s1, const BioSeq &s2) -> int {
+    return _full_align_bitwise_impl(s1, s2);
+}
+
+auto full_align(const BioSeq &s1, const BioSeq &s2) -> int {
+    return _full_align_impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+auto full_align(const TSeq1 &s1, const TSeq2 &s2) -> int {
+    return _full_align_impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _local_align_scalar_impl(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
     struct Value {
         int t, d;
 
@@ -136,28 +642,100 @@ auto local_align(const BioSeq &s1, const BioSeq &s2) -> Alignment {
         }
     }
 
-    Alignment result;
-    int len = m + opt.d;
-    result.range1 = {opt_i - len + 1, opt_i + 1};
-    result.range2 = {1, m + 1};
-    result.loss = opt.t;
+    return make_local_alignment(opt.t, opt.d, opt_i, m);
+}
+
+// one dispatch per sequence type.
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _local_align_impl(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
+    using LocalAlignFn = auto (*)(const TSeq1 &, const TSeq2 &) -> Alignment;
+
+    static const LocalAlignFn impl = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return &local_align_avx2<TSeq1, TSeq2>;
+        if (__builtin_cpu_supports("sse4.1"))
+            return &local_align_sse41<TSeq1, TSeq2>;
+        return &_local_align_scalar_impl<TSeq1, TSeq2>;
+#else
+        return &local_align_generic<TSeq1, TSeq2>;
+#endif
+    }();
+
+    return impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _banded_local_align_impl(const TSeq1 &s1, const TSeq2 &s2, int diagonal, int width) -> Alignment {
+    using BandedAlignFn = auto (*)(const TSeq1 &, const TSeq2 &, const Band &) -> Alignment;
+
+    static const BandedAlignFn impl = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return &banded_local_align_avx2<TSeq1, TSeq2>;
+#endif
+        return &banded_local_align_generic<TSeq1, TSeq2>;
+    }();
+
+    // i - j ranges over [-m, n], so this band covers the whole table.
+    int limit = std::max(1, std::max(int(s1.size()) - diagonal, int(s2.size()) + diagonal));
+    width = std::clamp(width, 1, limit);
+
+    // a path of loss t stays within t of the diagonal of any of its
+    // cells. widening the band by the loss found in it therefore takes
+    // in every path that meets the band and costs no more, and only a
+    // better path wholly outside the band can still be missed.
+    auto result = impl(s1, s2, {diagonal, width});
+    if (result.loss > 0 && width < limit)
+        result = impl(s1, s2, {diagonal, std::min(limit, width + result.loss)});
 
     return result;
 }
 
+auto local_align_scalar(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+    return _local_align_scalar_impl(s1, s2);
+}
+
+auto local_align(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+    return _local_align_impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+auto local_align(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
+    return _local_align_impl(s1, s2);
+}
+
+auto banded_local_align(const BioSeq &s1, const BioSeq &s2, int diagonal, int width) -> Alignment {
+    return _banded_local_align_impl(s1, s2, diagonal, width);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+auto banded_local_align(const TSeq1 &s1, const TSeq2 &s2, int diagonal, int width) -> Alignment {
+    return _banded_local_align_impl(s1, s2, diagonal, width);
+}
+
 auto Index::align(const BioSeq &s) const -> Alignment {
+    thread_local AlignWorkspace workspace;
+    return align(s, workspace);
+}
+
+auto Index::align(const BioSeq &s, AlignWorkspace &workspace) const -> Alignment {
+    return align<BioSeq>(s, workspace);
+}
+
+template <Sequence TSeq>
+auto Index::align(const TSeq &s, AlignWorkspace &workspace) const -> Alignment {
     int n = s.size();
-    std::priority_queue<State, std::vector<State>, Heuristic> q(Heuristic{n});
-    tsl::robin_map<Key, int> best;
+    auto &[q, best] = *workspace._impl;
+    q.clear(n);
+    best.clear();
 
     auto probe = [&best, &q](const State &v) {
-        auto it = best.find(v.key);
-
-        if (it == best.end()) {
-            best.insert({v.key, v.t});
-            q.push(v);
-        } else if (it->second > v.t) {
-            it.value() = v.t;
+        int &t = best[v.key];
+        if (v.t < t) {
+            t = v.t;
             q.push(v);
         }
     };
@@ -169,8 +747,7 @@ auto Index::align(const BioSeq &s) const -> Alignment {
 
     do {
         max_queue_size = std::max(max_queue_size, q.size());
-        auto u = q.top();
-        q.pop();
+        auto u = q.pop();
 
         if (u.t > best[u.key])
             continue;
@@ -184,8 +761,9 @@ auto Index::align(const BioSeq &s) const -> Alignment {
 
         probe({{x, y + 1}, u.t + FULL_COST, u.l});
 
+        auto transition = &_view.transition[x * ALPHABET_SIZE];
         for (int c = 0; c < ALPHABET_SIZE; c++) {
-            int z = m[x].transition[c];
+            int z = transition[c];
             if (!z)
                 continue;
 
@@ -205,4 +783,20 @@ auto Index::align(const BioSeq &s) const -> Alignment {
     };
 }
 
+template auto full_align(const BioSeq &, const RevComp<BioSeq> &) -> int;
+template auto full_align(const PackedView &, const PackedView &) -> int;
+template auto full_align(const PackedView &, const RevComp<PackedView> &) -> int;
+
+template auto local_align(const BioSeq &, const RevComp<BioSeq> &) -> Alignment;
+template auto local_align(const PackedView &, const PackedView &) -> Alignment;
+template auto local_align(const PackedView &, const RevComp<PackedView> &) -> Alignment;
+
+template auto banded_local_align(const BioSeq &, const RevComp<BioSeq> &, int, int) -> Alignment;
+template auto banded_local_align(const PackedView &, const PackedView &, int, int) -> Alignment;
+template auto banded_local_align(const PackedView &, const RevComp<PackedView> &, int, int) -> Alignment;
+
+template auto Index::align(const RevComp<BioSeq> &, AlignWorkspace &) const -> Alignment;
+template auto Index::align(const PackedView &, AlignWorkspace &) const -> Alignment;
+template auto Index::align(const RevComp<PackedView> &, AlignWorkspace &) const -> Alignment;
+
 }
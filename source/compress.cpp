@@ -0,0 +1,339 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#ifdef TASK2_ZSTD
+#include <zstd.h>
+#endif
+
+#include <climits>
+#include <cstring>
+
+#include <algorithm>
+
+#include "compress.hpp"
+#include "rash/pool.hpp"
+
+
+namespace {
+
+using core::u8;
+
+// bgzip never writes blocks that inflate to more than this.
+constexpr size_t BGZF_MAX_BLOCK_SIZE = 1 << 16;
+
+// consecutive BGZF blocks inflated by one task.
+constexpr size_t BLOCKS_PER_TASK = 64;
+
+// compressed bytes read at a time by DecodingReader for zstd.
+constexpr size_t INPUT_BUFFER_SIZE = 1 << 17;
+
+auto le16(const char *p) -> size_t {
+    return u8(p[0]) | size_t(u8(p[1])) << 8;
+}
+
+auto le32(const char *p) -> uint32_t {
+    return le16(p) | uint32_t(le16(p + 2)) << 16;
+}
+
+// size of the BGZF block at p, or 0 if p does not start one. the block
+// size is stored in a "BC" subfield of the gzip extra field.
+auto bgzf_block_size(const char *p, const char *end) -> size_t {
+    if (end - p < 18 || u8(p[0]) != 0x1f || u8(p[1]) != 0x8b || p[2] != 8 || !(p[3] & 4))
+        return 0;
+
+    size_t xlen = le16(p + 10);
+    const char *x = p + 12, *x_end = x + xlen;
+    if (x_end > end)
+        return 0;
+
+    while (x + 4 <= x_end) {
+        size_t slen = le16(x + 2);
+        if (x[0] == 'B' && x[1] == 'C' && slen == 2 && x + 6 <= x_end) {
+            size_t n = le16(x + 4) + 1;
+            return n >= 12 + xlen + 8 && n <= size_t(end - p) ? n : 0;
+        }
+
+        x += 4 + slen;
+    }
+
+    return 0;
+}
+
+// plain gzip, possibly several members back to back.
+auto inflate_gzip(const char *data, size_t size, std::string &out) -> bool {
+    z_stream z = {};
+    if (inflateInit2(&z, 15 + 16) != Z_OK)
+        return false;
+
+    // avail_in and avail_out are 32-bit.
+    const char *in = data, *in_end = data + size;
+    out.resize(std::max<size_t>(4 * size, BGZF_MAX_BLOCK_SIZE));
+    size_t written = 0;
+
+    bool ok = true;
+    while (true) {
+        if (z.avail_in == 0) {
+            size_t n = std::min<size_t>(in_end - in, UINT_MAX);
+            z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+            z.avail_in = n;
+            in += n;
+        }
+
+        if (written == out.size())
+            out.resize(2 * out.size());
+
+        size_t room = std::min<size_t>(out.size() - written, UINT_MAX);
+        z.next_out = reinterpret_cast<Bytef *>(out.data() + written);
+        z.avail_out = room;
+
+        int ret = inflate(&z, Z_NO_FLUSH);
+        written += room - z.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            if (z.avail_in == 0 && in == in_end)
+                break;
+
+            inflateReset(&z);
+        } else if (ret != Z_OK) {
+            ok = false;
+            break;
+        }
+    }
+
+    inflateEnd(&z);
+    out.resize(written);
+    return ok;
+}
+
+auto inflate_bgzf(const char *data, size_t size, std::string &out, ThreadPool *pool) -> bool {
+    struct Block {
+        size_t in_offset, in_size;
+        size_t out_offset, out_size;
+        uint32_t crc;
+    };
+
+    // the block headers give every block's place in the output up front.
+    std::vector<Block> blocks;
+    size_t out_size = 0;
+    for (const char *p = data, *end = data + size; p < end; ) {
+        size_t n = bgzf_block_size(p, end);
+        if (!n)
+            return false;
+
+        size_t header = 12 + le16(p + 10);
+        blocks.push_back({size_t(p - data) + header, n - header - 8, out_size, le32(p + n - 4), le32(p + n - 8)});
+        if (blocks.back().out_size > BGZF_MAX_BLOCK_SIZE)
+            return false;
+
+        out_size += blocks.back().out_size;
+        p += n;
+    }
+
+    out.resize(out_size);
+
+    auto inflate_blocks = [&](size_t first, size_t last) -> bool {
+        z_stream z = {};
+        if (inflateInit2(&z, -15) != Z_OK)
+            return false;
+
+        bool ok = true;
+        for (size_t k = first; ok && k < last; k++) {
+            auto &b = blocks[k];
+            auto output = reinterpret_cast<Bytef *>(out.data() + b.out_offset);
+
+            inflateReset(&z);
+            z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + b.in_offset));
+            z.avail_in = b.in_size;
+            z.next_out = output;
+            z.avail_out = b.out_size;
+
+            ok = inflate(&z, Z_FINISH) == Z_STREAM_END && z.avail_out == 0 &&
+                crc32(0, output, b.out_size) == b.crc;
+        }
+
+        inflateEnd(&z);
+        return ok;
+    };
+
+    if (!pool)
+        return inflate_blocks(0, blocks.size());
+
+    std::vector<int> ok((blocks.size() + BLOCKS_PER_TASK - 1) / BLOCKS_PER_TASK);
+    parallel_for(*pool, 0, ok.size(), [&](int t) {
+        size_t first = t * BLOCKS_PER_TASK;
+        ok[t] = inflate_blocks(first, std::min(blocks.size(), first + BLOCKS_PER_TASK));
+    }, 1);
+
+    return std::all_of(ok.begin(), ok.end(), [](int x) {
+        return x;
+    });
+}
+
+#ifdef TASK2_ZSTD
+auto decompress_zstd(const char *data, size_t size, std::string &out) -> bool {
+    auto stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    ZSTD_inBuffer in = {data, size, 0};
+    out.resize(std::max(4 * size, ZSTD_DStreamOutSize()));
+    size_t written = 0;
+
+    // ret is 0 once a frame has been fully decoded and flushed.
+    size_t ret = 0;
+    while (true) {
+        if (written == out.size())
+            out.resize(2 * out.size());
+
+        ZSTD_outBuffer output = {out.data() + written, out.size() - written, 0};
+        ret = ZSTD_decompressStream(stream, &output, &in);
+        written += output.pos;
+
+        if (ZSTD_isError(ret) || (in.pos == in.size && output.pos < output.size))
+            break;
+    }
+
+    ZSTD_freeDStream(stream);
+    out.resize(written);
+    return !ZSTD_isError(ret) && ret == 0;
+}
+#endif
+
+}
+
+namespace core {
+
+auto detect_compression(const char *data, size_t size) -> Compression {
+    if (size >= 4 && u8(data[0]) == 0x28 && u8(data[1]) == 0xb5 && u8(data[2]) == 0x2f && u8(data[3]) == 0xfd)
+        return Compression::ZSTD;
+    if (size >= 2 && u8(data[0]) == 0x1f && u8(data[1]) == 0x8b)
+        return bgzf_block_size(data, data + size) ? Compression::BGZF : Compression::GZIP;
+    return Compression::NONE;
+}
+
+auto decompress(const char *data, size_t size, std::string &out, ThreadPool *pool) -> bool {
+    switch (detect_compression(data, size)) {
+        case Compression::NONE:
+            out.assign(data, size);
+            return true;
+
+        case Compression::GZIP:
+            return inflate_gzip(data, size, out);
+
+        case Compression::BGZF:
+            return inflate_bgzf(data, size, out, pool);
+
+        case Compression::ZSTD:
+#ifdef TASK2_ZSTD
+            return decompress_zstd(data, size, out);
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+DecodingReader::~DecodingReader() {
+    close();
+}
+
+auto DecodingReader::open(const std::string &path) -> bool {
+    close();
+
+    _fd = ::open(path.data(), O_RDONLY);
+    if (_fd < 0)
+        return false;
+
+    char magic[4];
+    ssize_t n = pread(_fd, magic, sizeof(magic), 0);
+    _type = detect_compression(magic, std::max<ssize_t>(n, 0));
+
+    switch (_type) {
+        case Compression::NONE:
+            posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            return true;
+
+        case Compression::GZIP:
+        case Compression::BGZF:
+            // gzclose() closes the descriptor.
+            _state = gzdopen(_fd, "rb");
+            _fd = -1;
+            return _state != nullptr;
+
+        case Compression::ZSTD:
+#ifdef TASK2_ZSTD
+            _state = ZSTD_createDStream();
+            ZSTD_initDStream(static_cast<ZSTD_DStream *>(_state));
+            _input.resize(INPUT_BUFFER_SIZE);
+            return true;
+#else
+            close();
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+void DecodingReader::close() {
+    if (_state) {
+        if (_type == Compression::ZSTD) {
+#ifdef TASK2_ZSTD
+            ZSTD_freeDStream(static_cast<ZSTD_DStream *>(_state));
+#endif
+        } else
+            gzclose(static_cast<gzFile>(_state));
+    }
+
+    if (_fd >= 0)
+        ::close(_fd);
+
+    _fd = -1;
+    _type = Compression::NONE;
+    _state = nullptr;
+    _input.clear();
+    _input_pos = _input_end = 0;
+}
+
+auto DecodingReader::read(char *buffer, size_t size) -> i64 {
+    switch (_type) {
+        case Compression::NONE:
+            return _fd < 0 ? -1 : ::read(_fd, buffer, size);
+
+        case Compression::GZIP:
+        case Compression::BGZF:
+            return gzread(static_cast<gzFile>(_state), buffer, std::min<size_t>(size, INT_MAX));
+
+        case Compression::ZSTD: {
+#ifdef TASK2_ZSTD
+            auto stream = static_cast<ZSTD_DStream *>(_state);
+            ZSTD_outBuffer output = {buffer, size, 0};
+            while (output.pos == 0) {
+                if (_input_pos == _input_end) {
+                    ssize_t n = ::read(_fd, _input.data(), _input.size());
+                    if (n <= 0)
+                        return n;
+
+                    _input_pos = 0;
+                    _input_end = n;
+                }
+
+                ZSTD_inBuffer input = {_input.data() + _input_pos, _input_end - _input_pos, 0};
+                size_t ret = ZSTD_decompressStream(stream, &output, &input);
+                _input_pos += input.pos;
+                if (ZSTD_isError(ret))
+                    return -1;
+            }
+
+            return output.pos;
+#else
+            return -1;
+#endif
+        }
+    }
+
+    return -1;
+}
+
+}
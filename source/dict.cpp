@@ -1,35 +1,108 @@
+#include <cstdio>
 #include <cctype>
-#include <cassert>
+#include <cstring>
 
+#include <sstream>
 #include <fstream>
+#include <iterator>
 #include <algorithm>
+#include <string_view>
 
 #include "dict.hpp"
+#include "file.hpp"
+#include "rash/pool.hpp"
 
 
 namespace {
 
-void trim(std::string &s) {
-    size_t i;
+// files are split into chunks of at least this many bytes, and at most
+// SPLIT_FACTOR per worker, for parallel parsing.
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+constexpr int SPLIT_FACTOR = 4;
 
-    for (i = 0; i < s.size(); i++) {
-        if (isalnum(s[i]))
-            break;
+// initial buffer of FastaReader. it grows to hold the longest line.
+constexpr size_t READ_BUFFER_SIZE = 1 << 20;
+
+// first line of a FastaIndex sidecar, followed by the version and the
+// stamp of the FASTA file.
+constexpr char SIDECAR_MAGIC[] = "#t2idx";
+constexpr int SIDECAR_VERSION = 1;
+
+// s without the non-alphanumeric characters at both ends.
+auto trim(std::string_view s) -> std::string_view {
+    size_t i = 0, j = s.size();
+    while (i < j && !isalnum(s[i])) {
+        i++;
+    }
+    while (j > i && !isalnum(s[j - 1])) {
+        j--;
     }
 
-    if (i > 0)
-        s.erase(0, i);
+    return s.substr(i, j - i);
+}
+
+// the first '>' at the start of a line in [p, end), or end. p must not
+// be the start of the file.
+auto next_record(const char *p, const char *end) -> const char * {
+    while (p < end) {
+        p = static_cast<const char *>(memchr(p, '>', end - p));
+        if (!p)
+            return end;
+        if (p[-1] == '\n')
+            return p;
 
-    if (s.size() > 0) {
-        assert(isalnum(s[0]));
+        p++;
+    }
 
-        for (i = s.size() - 1; ; i--) {
-            if (isalnum(s[i]))
-                break;
+    return end;
+}
+
+// the trimmed lines of [p, end) joined together.
+auto join_lines(const char *p, const char *end) -> std::string {
+    std::string sequence;
+    sequence.reserve(end - p);
+    while (p < end) {
+        auto eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        sequence.append(trim(std::string_view(p, eol - p)));
+        p = eol + 1;
+    }
+
+    return sequence;
+}
+
+// packed, sequence goes into e.packed and e.sequence is left empty.
+void set_sequence(core::DictEntry &e, std::string &&sequence, bool packed) {
+    if (packed) {
+        e.sequence.clear();
+        e.packed = core::PackedSeq(sequence);
+    } else
+        e.sequence = std::move(sequence);
+}
+
+// a record is a ">" line followed by its sequence, which may be
+// wrapped over several lines.
+void parse(const char *p, const char *end, bool packed, std::vector<core::DictEntry> &entries) {
+    while (p < end) {
+        auto eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        if (*p != '>') {
+            p = eol + 1;
+            continue;
+        }
+
+        auto name = trim(std::string_view(p, eol - p));
+        auto next = next_record(eol, end);
+        if (!name.empty()) {
+            entries.emplace_back(std::string(name), "");
+            set_sequence(entries.back(), join_lines(eol, next), packed);
         }
 
-        if (i + 1 < s.size())
-            s.erase(i + 1);
+        p = next;
     }
 }
 
@@ -37,31 +110,85 @@ void trim(std::string &s) {
 
 namespace core {
 
-void Dict::load_file(const std::string &path) {
+auto Dict::load_file(const std::string &path, bool packed, ThreadPool *pool) -> bool {
     _entries.clear();
     _index.clear();
 
-    std::fstream fp(path);
-    while (fp) {
-        std::string name, sequence;
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    // compressed files are decoded into memory first.
+    std::string decoded;
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    if (detect_compression(begin, file.size()) != Compression::NONE) {
+        if (!decompress(begin, file.size(), decoded, pool))
+            return false;
+
+        file.close();
+        begin = decoded.data();
+        end = begin + decoded.size();
+    }
 
-        do {
-            std::getline(fp, name);
-        } while (name.empty() && fp);
+    size_t size = end - begin;
+    if (!pool || size < 2 * MIN_CHUNK_SIZE) {
+        parse(begin, end, packed, _entries);
+        return true;
+    }
 
-        trim(name);
+    // cut the file at the first record start after every chunk size
+    // bytes. the chunks are parsed in parallel and joined in order.
+    size_t n_chunks = std::min<size_t>(SPLIT_FACTOR * pool->size(), size / MIN_CHUNK_SIZE);
+    size_t chunk_size = size / n_chunks;
+    std::vector<const char *> cuts = {begin};
+    for (size_t k = 1; k < n_chunks; k++) {
+        auto p = next_record(std::max(cuts.back(), begin + k * chunk_size), end);
+        if (p == end)
+            break;
+        if (p != cuts.back())
+            cuts.push_back(p);
+    }
+    cuts.push_back(end);
 
-        if (name.empty())
-            return;
+    std::vector<std::vector<DictEntry>> chunks(cuts.size() - 1);
+    parallel_for(*pool, 0, chunks.size(), [&](int k) {
+        parse(cuts[k], cuts[k + 1], packed, chunks[k]);
+    }, 1);
 
-        do {
-            assert(fp);
-            std::getline(fp, sequence);
-        } while (sequence.empty());
+    size_t n = 0;
+    for (auto &chunk : chunks) {
+        n += chunk.size();
+    }
 
-        trim(sequence);
-        _entries.emplace_back(name, sequence);
+    _entries.reserve(n);
+    for (auto &chunk : chunks) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(_entries));
     }
+
+    return true;
+}
+
+auto Dict::load_records(
+    const std::string &path, const std::vector<std::string> &names, bool packed
+) -> bool {
+    _entries.clear();
+    _index.clear();
+
+    FastaIndex fai;
+    if (!fai.open(path))
+        return false;
+
+    bool found = true;
+    for (auto &name : names) {
+        DictEntry e;
+        if (fai.fetch(name, e, packed))
+            _entries.push_back(std::move(e));
+        else
+            found = false;
+    }
+
+    return found;
 }
 
 void Dict::sort_by_name() {
@@ -97,4 +224,243 @@ auto Dict::find(const std::string &name) const -> DictEntry * {
     }
 }
 
+FastaReader::~FastaReader() {
+    close();
+}
+
+auto FastaReader::open(const std::string &path) -> bool {
+    close();
+
+    if (!_input.open(path))
+        return false;
+
+    _buffer.resize(READ_BUFFER_SIZE);
+    return true;
+}
+
+void FastaReader::close() {
+    _input.close();
+    _eof = false;
+    _buffer.clear();
+    _begin = _end = 0;
+    _header.clear();
+    _has_header = false;
+}
+
+auto FastaReader::_getline(std::string_view &line) -> bool {
+    size_t scanned = _begin;
+    while (true) {
+        auto eol = static_cast<const char *>(memchr(_buffer.data() + scanned, '\n', _end - scanned));
+        if (eol) {
+            line = std::string_view(_buffer.data() + _begin, eol - _buffer.data() - _begin);
+            _begin = eol - _buffer.data() + 1;
+            return true;
+        }
+
+        if (_eof || _buffer.empty()) {
+            if (_begin == _end)
+                return false;
+
+            line = std::string_view(_buffer.data() + _begin, _end - _begin);
+            _begin = _end;
+            return true;
+        }
+
+        // move the partial line to the front and read more after it.
+        std::copy(_buffer.begin() + _begin, _buffer.begin() + _end, _buffer.begin());
+        _end -= _begin;
+        scanned = _end;
+        _begin = 0;
+        if (_end == _buffer.size())
+            _buffer.resize(2 * _buffer.size());
+
+        auto n = _input.read(_buffer.data() + _end, _buffer.size() - _end);
+        if (n <= 0)
+            _eof = true;
+        else
+            _end += n;
+    }
+}
+
+auto FastaReader::next(DictEntry &e, bool packed) -> bool {
+    std::string_view line;
+    while (!_has_header) {
+        if (!_getline(line))
+            return false;
+
+        if (line.starts_with('>')) {
+            _header = trim(line);
+            _has_header = !_header.empty();
+        }
+    }
+
+    e.name = std::move(_header);
+    _has_header = false;
+
+    std::string sequence;
+    while (_getline(line)) {
+        if (line.starts_with('>')) {
+            _header = trim(line);
+            _has_header = !_header.empty();
+            break;
+        }
+
+        sequence.append(trim(line));
+    }
+
+    set_sequence(e, std::move(sequence), packed);
+    return true;
+}
+
+auto FastaIndex::open(const std::string &path) -> bool {
+    _records.clear();
+    _index.clear();
+
+    if (!_file.open(path))
+        return false;
+
+    // offsets of a compressed file refer to its decoded contents, which
+    // are then kept in memory.
+    _data = _file.data();
+    _size = _file.size();
+    if (detect_compression(_data, _size) != Compression::NONE) {
+        if (!decompress(_data, _size, _decoded))
+            return false;
+
+        _file.close();
+        _data = _decoded.data();
+        _size = _decoded.size();
+    }
+
+    // failing to save only means scanning again next time.
+    FileStamp stamp;
+    bool stamped = stamp_file(path, stamp);
+    auto sidecar = path + ".t2idx";
+    if (!stamped || !_load(sidecar, stamp)) {
+        _scan();
+        if (stamped)
+            _save(sidecar, stamp);
+    }
+
+    for (int k = 0; k < _records.size(); k++) {
+        _index[_records[k].name] = k;
+    }
+
+    return true;
+}
+
+auto FastaIndex::find(const std::string &name) const -> const Record * {
+    auto it = _index.find(name);
+    if (it == _index.end())
+        return nullptr;
+    return &_records[it->second];
+}
+
+auto FastaIndex::fetch(const std::string &name, DictEntry &e, bool packed) const -> bool {
+    auto r = find(name);
+    if (!r)
+        return false;
+
+    const char *begin = _data + r->offset;
+    const char *end = _data + _size;
+
+    e.name = r->name;
+    set_sequence(e, join_lines(begin, next_record(begin, end)), packed);
+    return true;
+}
+
+// same records as parse(). line_bases and line_width are those of the
+// first sequence line.
+void FastaIndex::_scan() {
+    _records.clear();
+
+    const char *begin = _data;
+    const char *end = begin + _size;
+    const char *p = begin;
+    while (p < end) {
+        auto eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        if (*p != '>') {
+            p = eol + 1;
+            continue;
+        }
+
+        auto name = trim(std::string_view(p, eol - p));
+        auto next = next_record(eol, end);
+        if (!name.empty()) {
+            Record r = {std::string(name), 0, size_t(std::min(eol + 1, end) - begin), 0, 0};
+            for (const char *q = eol + 1; q < next; ) {
+                auto eol = static_cast<const char *>(memchr(q, '\n', next - q));
+                if (!eol)
+                    eol = next;
+
+                int n = trim(std::string_view(q, eol - q)).size();
+                if (r.line_width == 0) {
+                    r.line_bases = n;
+                    r.line_width = eol - q + 1;
+                }
+
+                r.length += n;
+                q = eol + 1;
+            }
+
+            _records.push_back(std::move(r));
+        }
+
+        p = next;
+    }
+}
+
+auto FastaIndex::_load(const std::string &path, const FileStamp &stamp) -> bool {
+    std::ifstream fp(path);
+    if (!fp)
+        return false;
+
+    std::string line, magic;
+    int version = 0;
+    FileStamp saved;
+    if (!std::getline(fp, line))
+        return false;
+
+    std::istringstream header(line);
+    header >> magic >> version >> saved.size >> saved.mtime;
+    if (!header || magic != SIDECAR_MAGIC || version != SIDECAR_VERSION || saved != stamp)
+        return false;
+
+    while (std::getline(fp, line)) {
+        Record r;
+        std::istringstream buffer(line);
+        std::getline(buffer, r.name, '\t');
+        buffer >> r.length >> r.offset >> r.line_bases >> r.line_width;
+
+        if (!buffer || r.name.empty() || r.offset == 0 || r.offset > _size) {
+            _records.clear();
+            return false;
+        }
+
+        _records.push_back(std::move(r));
+    }
+
+    return true;
+}
+
+auto FastaIndex::_save(const std::string &path, const FileStamp &stamp) const -> bool {
+    FILE *fp = fopen(path.data(), "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "%s\t%d\t%llu\t%lld\n",
+        SIDECAR_MAGIC, SIDECAR_VERSION,
+        (unsigned long long) stamp.size, (long long) stamp.mtime
+    );
+
+    for (auto &r : _records) {
+        fprintf(fp, "%s\t%zu\t%zu\t%d\t%d\n", r.name.data(), r.length, r.offset, r.line_bases, r.line_width);
+    }
+
+    return fclose(fp) == 0;
+}
+
 }
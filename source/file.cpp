@@ -0,0 +1,78 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <utility>
+
+#include "file.hpp"
+
+
+namespace core {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&rhs)
+    : _data(std::exchange(rhs._data, nullptr)),
+      _size(std::exchange(rhs._size, 0)) {}
+
+auto MappedFile::operator=(MappedFile &&rhs) -> MappedFile & {
+    if (this != &rhs) {
+        close();
+        _data = std::exchange(rhs._data, nullptr);
+        _size = std::exchange(rhs._size, 0);
+    }
+
+    return *this;
+}
+
+auto MappedFile::open(const std::string &path) -> bool {
+    close();
+
+    int fd = ::open(path.data(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap refuses empty mappings. an empty file is still a valid file.
+    if (info.st_size > 0) {
+        void *ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+
+        _data = static_cast<const char *>(ptr);
+        _size = info.st_size;
+    }
+
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        munmap(const_cast<char *>(_data), _size);
+
+    _data = nullptr;
+    _size = 0;
+}
+
+auto stamp_file(const std::string &path, FileStamp &stamp) -> bool {
+    struct stat st;
+    if (stat(path.data(), &st) != 0)
+        return false;
+
+    stamp.size = st.st_size;
+    stamp.mtime = i64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+}
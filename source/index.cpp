@@ -1,105 +1,416 @@
+#include <cstring>
+#include <cassert>
+
+#include <fstream>
 #include <algorithm>
 
 #include "index.hpp"
 
+#include "rash/pool.hpp"
+
+
+namespace {
+
+constexpr char IMAGE_MAGIC[8] = {'T', '2', 'I', 'N', 'D', 'E', 'X', 0};
+constexpr core::u64 IMAGE_VERSION = 4;
+
+// followed by the columns transition, fail, maxlen, dfn, sorted and starts.
+struct ImageHeader {
+    char magic[8];
+    core::u64 version;
+    core::u64 alphabet_size;
+    core::i64 n_appended;
+    core::u64 text_hash;
+    core::i64 last;
+    core::i64 n_nodes;
+    core::i64 n_sorted;
+    core::i64 n_starts;
+};
+
+constexpr int SPLIT_FACTOR = 8;
+constexpr int MAX_SPLIT_DEPTH = 8;
+
+// fail tree in CSR form: children of x are children[offset[x]..offset[x + 1]),
+// in increasing order.
+struct FailTree {
+    std::vector<int> offset, children;
+
+    FailTree(std::span<const int> fail) {
+        int n = fail.size();
+        offset.resize(n + 1);
+        children.resize(std::max(0, n - 2));
+
+        // counting sort by fail. filling from the back leaves offset[x]
+        // at the start of x's range.
+        for (int i = 2; i < n; i++) {
+            offset[fail[i]]++;
+        }
+        for (int i = 1; i <= n; i++) {
+            offset[i] += offset[i - 1];
+        }
+        for (int i = n - 1; i >= 2; i--) {
+            children[--offset[fail[i]]] = i;
+        }
+    }
+
+    auto size_of(int x) const -> int {
+        int size = 0;
+        std::vector<int> stack = {x};
+        while (!stack.empty()) {
+            int u = stack.back();
+            stack.pop_back();
+            size++;
+            stack.insert(stack.end(), children.begin() + offset[u], children.begin() + offset[u + 1]);
+        }
+
+        return size;
+    }
+};
+
+// numbers the subtree of root in preorder from count + 1 with an explicit
+// stack. skip(x) returns the size of a subtree numbered elsewhere, which
+// then only gets its own dfn range, or 0 to descend as usual.
+template <typename TSkipFn>
+void euler_tour(
+    const FailTree &tree, int root, int count,
+    std::span<const int> index, core::Range *dfn, int *sorted,
+    const TSkipFn &skip
+) {
+    // (state, next child)
+    std::vector<std::pair<int, int>> stack;
+
+    auto enter = [&](int x) {
+        dfn[x].begin = ++count;
+        sorted[count] = index[x];
+
+        int size = skip(x);
+        if (size > 0) {
+            count += size - 1;
+            dfn[x].end = count + 1;
+        } else
+            stack.push_back({x, tree.offset[x]});
+    };
+
+    enter(root);
+    while (!stack.empty()) {
+        auto &[x, i] = stack.back();
+        if (i < tree.offset[x + 1])
+            enter(tree.children[i++]);
+        else {
+            dfn[x].end = count + 1;
+            stack.pop_back();
+        }
+    }
+}
+
+template <typename T>
+void write_column(std::ofstream &fp, std::span<const T> column) {
+    fp.write(reinterpret_cast<const char *>(column.data()), column.size_bytes());
+}
+
+template <typename T>
+auto read_column(const char *&ptr, size_t n) -> std::span<const T> {
+    auto column = std::span<const T>(reinterpret_cast<const T *>(ptr), n);
+    ptr += column.size_bytes();
+    return column;
+}
+
+}
 
 namespace core {
 
 Index::Index() {
     _allocate(2);  // 0 & 1
-    m[0].maxlen = -1;
-    std::fill(
-        std::begin(m[0].transition),
-        std::end(m[0].transition),
-        1
-    );
+    _data.maxlen[0] = -1;
+    for (int c = 0; c < ALPHABET_SIZE; c++) {
+        _transition(0, c) = 1;
+    }
+    _attach();
+}
+
+void Index::_attach() {
+    _view.transition = _data.transition;
+    _view.fail = _data.fail;
+    _view.maxlen = _data.maxlen;
+    _view.dfn = _data.dfn;
+    _view.sorted = _data.sorted;
+    _view.starts = _data.starts;
 }
 
 auto Index::_allocate(int n) -> int {
-    m.resize(m.size() + n);
-    return m.size() - 1;
+    size_t size = _data.fail.size() + n;
+    _data.transition.resize(size * ALPHABET_SIZE);
+    _data.fail.resize(size);
+    _data.maxlen.resize(size);
+    _data.index.resize(size);
+    return size - 1;
 }
 
 void Index::_copy(int dst, int src) {
-    m[dst].fail = m[src].fail;
-    m[dst].index = m[src].index;
-    std::copy(
-        std::begin(m[src].transition),
-        std::end(m[src].transition),
-        std::begin(m[dst].transition)
-    );
+    _data.fail[dst] = _data.fail[src];
+    _data.index[dst] = _data.index[src];
+    for (int c = 0; c < ALPHABET_SIZE; c++) {
+        _transition(dst, c) = _transition(src, c);
+    }
 }
 
 auto Index::_append(int x, int c) -> int {
     _n_appended++;
 
+    auto &fail = _data.fail;
+    auto &maxlen = _data.maxlen;
+
     int y = _allocate(1);
-    m[y].index = m[y].maxlen = m[x].maxlen + 1;
+    _data.index[y] = maxlen[y] = maxlen[x] + 1;
 
-    while (!m[x].transition[c]) {
-        m[x].transition[c] = y;
-        x = m[x].fail;
+    while (!_transition(x, c)) {
+        _transition(x, c) = y;
+        x = fail[x];
     }
 
-    int p = m[x].transition[c];
-    if (m[x].maxlen + 1 != m[p].maxlen) {
+    int p = _transition(x, c);
+    if (maxlen[x] + 1 != maxlen[p]) {
         int q = _allocate(1);
         _copy(q, p);
-        m[q].maxlen = m[x].maxlen + 1;
-        m[p].fail = m[y].fail = q;
+        maxlen[q] = maxlen[x] + 1;
+        fail[p] = fail[y] = q;
 
-        while (m[x].transition[c] == p) {
-            m[x].transition[c] = q;
-            x = m[x].fail;
+        while (_transition(x, c) == p) {
+            _transition(x, c) = q;
+            x = fail[x];
         }
     } else
-        m[y].fail = p;
+        fail[y] = p;
 
     return y;
 }
 
+template <Sequence TSeq>
+void TextFingerprint::_append_sequence(const TSeq &s) {
+    for (int i = 1; i <= s.size(); i++) {
+        append(CMAP[static_cast<u8>(s[i])]);
+    }
+}
+
+void TextFingerprint::append(const BioSeq &s) {
+    _append_sequence(s);
+}
+
+void TextFingerprint::append(const PackedView &s) {
+    _append_sequence(s);
+}
+
+void TextFingerprint::append_reference(const BioSeq &s) {
+    _append_sequence(s);
+    append(CMAP['N']);
+}
+
+void TextFingerprint::append_reference(const PackedView &s) {
+    _append_sequence(s);
+    append(CMAP['N']);
+}
+
 void Index::append(int c) {
+    assert(!_data.fail.empty() && "index loaded from an image is read-only");
     _last = _append(_last, c);
+    _text.append(c);
+    _attach();
 }
 
-void Index::append(const BioSeq &s) {
-    for (auto c : s) {
-        append(CMAP[static_cast<u8>(c)]);
+template <Sequence TSeq>
+void Index::_append_sequence(const TSeq &s) {
+    // a suffix automaton has at most 2n states. reserving up front
+    // avoids the reallocation peaks of growing five columns one by one.
+    size_t n_states = 2 * (size_t(_n_appended) + s.size()) + 2;
+    _data.transition.reserve(n_states * ALPHABET_SIZE);
+    _data.fail.reserve(n_states);
+    _data.maxlen.reserve(n_states);
+    _data.index.reserve(n_states);
+
+    for (int i = 1; i <= s.size(); i++) {
+        append(CMAP[static_cast<u8>(s[i])]);
     }
 }
 
-void Index::build() {
-    for (int i = 1; i < m.size(); i++) {
-        m[i].children.clear();
+template <Sequence TSeq>
+void Index::_append_reference(const TSeq &s) {
+    if (_data.starts.empty())
+        _data.starts.push_back(_n_appended);
+
+    _append_sequence(s);
+    append(CMAP['N']);
+    _data.starts.push_back(_n_appended);
+    _attach();
+}
+
+void Index::append(const BioSeq &s) {
+    _append_sequence(s);
+}
+
+void Index::append(const PackedView &s) {
+    _append_sequence(s);
+}
+
+void Index::append_reference(const BioSeq &s) {
+    _append_reference(s);
+}
+
+void Index::append_reference(const PackedView &s) {
+    _append_reference(s);
+}
+
+auto Index::n_references() const -> int {
+    return std::max(1, int(_view.starts.size()) - 1);
+}
+
+auto Index::reference_of(int pos) const -> int {
+    if (_view.starts.empty())
+        return 0;
+
+    auto it = std::upper_bound(_view.starts.begin(), _view.starts.end(), pos - 1);
+    int ref = it - _view.starts.begin() - 1;
+    return std::clamp(ref, 0, n_references() - 1);
+}
+
+auto Index::reference_range(int ref) const -> Range {
+    if (_view.starts.empty())
+        return {1, size() + 1};
+
+    return {_view.starts[ref] + 1, _view.starts[ref + 1]};
+}
+
+void Index::build(ThreadPool *pool) {
+    int n = _data.fail.size();
+    FailTree tree(_data.fail);
+
+    _data.dfn.clear();
+    _data.dfn.resize(n);
+    _data.sorted.clear();
+    _data.sorted.resize(n);
+
+    auto index = std::span<const int>(_data.index);
+    auto dfn = _data.dfn.data();
+    auto sorted = _data.sorted.data();
+
+    if (!pool) {
+        euler_tour(tree, 1, 0, index, dfn, sorted, [](int) {
+            return 0;
+        });
+        _attach();
+        return;
     }
 
-    for (int i = 2; i < m.size(); i++) {
-        int p = m[i].fail;
-        m[p].children.push_back(i);
+    // cut the top of the tree until there are enough subtrees to keep
+    // every worker busy. the subtrees are sized and numbered in parallel,
+    // the few states above them serially in between.
+    std::vector<int> frontier = {1}, next;
+    for (int level = 0; level < MAX_SPLIT_DEPTH && frontier.size() < SPLIT_FACTOR * pool->size(); level++) {
+        next.clear();
+        for (int x : frontier) {
+            if (tree.offset[x] == tree.offset[x + 1])
+                next.push_back(x);
+            else for (int i = tree.offset[x]; i < tree.offset[x + 1]; i++) {
+                next.push_back(tree.children[i]);
+            }
+        }
+
+        std::swap(frontier, next);
     }
 
-    _sorted.clear();
-    _sorted.resize(m.size());
-    int count = 0;
-    _traverse(1, count);
+    std::sort(frontier.begin(), frontier.end());
+    std::vector<int> subtree_size;
+    subtree_size.resize(frontier.size());
+
+    auto parallel = [pool, &frontier](auto &&fn) {
+        parallel_for(*pool, 0, frontier.size(), fn, 1);
+    };
+
+    parallel([&](int k) {
+        subtree_size[k] = tree.size_of(frontier[k]);
+    });
+
+    euler_tour(tree, 1, 0, index, dfn, sorted, [&](int x) {
+        auto it = std::lower_bound(frontier.begin(), frontier.end(), x);
+        if (it == frontier.end() || *it != x)
+            return 0;
+        return subtree_size[it - frontier.begin()];
+    });
+
+    parallel([&](int k) {
+        int x = frontier[k];
+        euler_tour(tree, x, dfn[x].begin - 1, index, dfn, sorted, [](int) {
+            return 0;
+        });
+    });
+
+    _attach();
 }
 
-void Index::_traverse(int x, int &count) {
-    count++;
-    m[x].dfn.in = count;
-    _sorted[count] = m[x].index;
+auto Index::save(const std::string &path) const -> bool {
+    ImageHeader header;
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.alphabet_size = ALPHABET_SIZE;
+    header.n_appended = _n_appended;
+    header.text_hash = _text.hash();
+    header.last = _last;
+    header.n_nodes = _view.fail.size();
+    header.n_sorted = _view.sorted.size();
+    header.n_starts = _view.starts.size();
 
-    for (int v : m[x].children) {
-        _traverse(v, count);
-    }
+    std::ofstream fp(path, std::ios::binary | std::ios::trunc);
+    fp.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_column(fp, _view.transition);
+    write_column(fp, _view.fail);
+    write_column(fp, _view.maxlen);
+    write_column(fp, _view.dfn);
+    write_column(fp, _view.sorted);
+    write_column(fp, _view.starts);
+
+    return fp.good();
+}
+
+auto Index::load(const std::string &path, const TextFingerprint &text) -> bool {
+    MappedFile image;
+    if (!image.open(path) || image.size() < sizeof(ImageHeader))
+        return false;
+
+    auto &header = *reinterpret_cast<const ImageHeader *>(image.data());
+    if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header.version != IMAGE_VERSION ||
+        header.alphabet_size != ALPHABET_SIZE ||
+        header.n_appended != text.length() ||
+        header.text_hash != text.hash())
+        return false;
+
+    size_t n = header.n_nodes;
+    size_t expected = sizeof(ImageHeader) +
+        n * (ALPHABET_SIZE + 2) * sizeof(int) +
+        n * sizeof(Range) +
+        (header.n_sorted + header.n_starts) * sizeof(int);
+    if (image.size() != expected)
+        return false;
+
+    auto ptr = image.data() + sizeof(ImageHeader);
+    _view.transition = read_column<int>(ptr, n * ALPHABET_SIZE);
+    _view.fail = read_column<int>(ptr, n);
+    _view.maxlen = read_column<int>(ptr, n);
+    _view.dfn = read_column<Range>(ptr, n);
+    _view.sorted = read_column<int>(ptr, header.n_sorted);
+    _view.starts = read_column<int>(ptr, header.n_starts);
+
+    _data = {};
+    _n_appended = header.n_appended;
+    _text = text;
+    _last = header.last;
+    _image = std::move(image);
 
-    m[x].dfn.out = count;
+    return true;
 }
 
 auto Index::rpset(const Token &t) const -> std::vector<int> {
-    int l = m[t.id].dfn.in;
-    int r = m[t.id].dfn.out + 1;
-    std::vector<int> set(_sorted.begin() + l, _sorted.begin() + r);
+    auto [l, r] = _view.dfn[t.id];
+    std::vector<int> set(_view.sorted.begin() + l, _view.sorted.begin() + r);
 
     std::sort(set.begin(), set.end());
     set.erase(unique(set.begin(), set.end()), set.end());
@@ -109,12 +420,12 @@ auto Index::rpset(const Token &t) const -> std::vector<int> {
 
 auto Index::next(const Token &t, int c) const -> Token {
     auto [x, l] = t;
-    while (!m[x].transition[c]) {
-        x = m[x].fail;
-        l = m[x].maxlen;
+    while (!_view.transition[x * ALPHABET_SIZE + c]) {
+        x = _view.fail[x];
+        l = _view.maxlen[x];
     }
 
-    return {m[x].transition[c], l + 1};
+    return {_view.transition[x * ALPHABET_SIZE + c], l + 1};
 }
 
 auto Index::locate(const BioSeq &s) const -> Token {
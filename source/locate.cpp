@@ -1,10 +1,9 @@
-#include <queue>
-#include <unordered_map>
+#include <climits>
+#include <cassert>
+#include <algorithm>
 
 #include "core.hpp"
 
-#include "tsl/robin_map.h"
-
 
 namespace {
 
@@ -13,51 +12,143 @@ constexpr int STEP = 3;
 constexpr int MIN_BUCKET_SIZE = 850;
 constexpr int NUM_SEQ = 2;
 constexpr int MIN_THRESHOLD = 10;
+constexpr double DIAGONAL_TRIM = 0.05;
+// reads expecting fewer minimizers than this are seeded every STEP bases.
+constexpr int MIN_MINIMIZER_SEEDS = 50;
 
 }
 
 namespace core {
 
 auto Index::fuzzy_locate(const BioSeq &seq) const -> Location {
-    int n = seq.size();
+    thread_local AlignWorkspace workspace;
+    return fuzzy_locate(seq, workspace);
+}
+
+template <Sequence TSeq>
+auto Index::_walk(const TSeq &s) const -> Token {
+    Token t;
+    for (int i = 1; i <= s.size(); i++) {
+        int z = _view.transition[t.id * ALPHABET_SIZE + CMAP[s[i]]];
+        if (!z)
+            break;
+
+        t = {z, i};
+    }
+
+    return t;
+}
+
+auto Index::fuzzy_locate(
+    const BioSeq &seq, AlignWorkspace &workspace, const LocateOptions &options
+) const -> Location {
+    return _fuzzy_locate(seq, workspace, options);
+}
+
+auto Index::fuzzy_locate(
+    const PackedView &seq, AlignWorkspace &workspace, const LocateOptions &options
+) const -> Location {
+    return _fuzzy_locate(seq, workspace, options);
+}
 
-    std::string rev_seq = watson_crick_complement(*seq.internal);
-    BioSeq s[NUM_SEQ] = {seq, rev_seq};
+template <Sequence TSeq>
+auto Index::_fuzzy_locate(
+    const TSeq &seq, AlignWorkspace &workspace, const LocateOptions &options
+) const -> Location {
+    int n = seq.size();
+    Location result;
 
     int bucket_size = std::max(MIN_BUCKET_SIZE, n / 2);
-    // tsl::robin_map<int, int> bucket[2];
-    std::unordered_map<int, int> bucket[2];
 
-    auto put = [&bucket, bucket_size](int i, int j) {
-        j /= bucket_size;
-        bucket[i][j]++;
+    // (bucket, diagonal) of every hit, diagonal being the reference
+    // position minus the read position at the end of the k-mer.
+    std::vector<std::pair<int, int>> hits[NUM_SEQ];
+
+    auto vote = [&](int i, int l, int len, int j) {
+        hits[i].emplace_back((j - len / 2) / bucket_size, j - (l + KMER - 1));
     };
 
-    auto probe = [&bucket](int i, int j) -> int {
-        auto it = bucket[i].find(j);
-        if (it != bucket[i].end())
-            return it->second;
-        return 0;
+    // s is seq (i = 0) or its reverse complement (i = 1).
+    auto seed = [&](int i, const auto &s, int l) {
+        auto kmer = s.take(l, l + KMER);
+
+        // the all-match path is the cheapest one and A* always takes
+        // it, so an exact occurrence gives the same token directly.
+        Token t;
+        if (options.exact_seeds && (t = _walk(kmer)).len == KMER)
+            result.seeds.n_exact++;
+        else {
+            auto alignment = align(kmer, workspace);
+            t = alignment.token;
+            result.seeds.n_aligned++;
+            result.seeds.n_state_visited += alignment.debug.n_state_visited;
+        }
+
+        for (int j : rpset(t)) {
+            vote(i, l, t.len, j);
+        }
     };
 
-    for (int i = 0; i < NUM_SEQ; i++) {
-        for (int l = 1; l + KMER - 1 <= n; l += STEP) {
-            auto t = align(s[i].take(l, l + KMER)).token;
+    auto table = options.minimizers;
+    assert((!table || table->kmer() == KMER) && "minimizer table built with a different k");
 
-            for (int j : rpset(t)) {
-                put(i, j - t.len / 2);
+    // a random sequence has 2 / (w + 1) of its k-mers as minimizers.
+    if (table && 2 * (n - KMER + 1) < MIN_MINIMIZER_SEEDS * (table->window() + 1))
+        table = nullptr;
+
+    auto seed_all = [&](int i, const auto &s) {
+        if (!table) {
+            for (int l = 1; l + KMER - 1 <= n; l += STEP) {
+                seed(i, s, l);
+            }
+
+            return;
+        }
+
+        for (auto [hash, l] : minimizers(s, table->window(), KMER)) {
+            auto found = table->find(hash);
+            if (!found)
+                seed(i, s, l);
+            else if (found->empty())
+                result.seeds.n_repetitive++;
+            else {
+                result.seeds.n_table++;
+                for (int j : *found) {
+                    vote(i, l, KMER, j);
+                }
             }
         }
+    };
+
+    seed_all(0, seq);
+    seed_all(1, reverse_complement(seq));
+
+    // votes per bucket as (bucket, count) runs of the sorted hits.
+    std::vector<std::pair<int, int>> bucket[NUM_SEQ];
+    for (int i = 0; i < NUM_SEQ; i++) {
+        std::sort(hits[i].begin(), hits[i].end());
+
+        for (auto [j, diagonal] : hits[i]) {
+            if (bucket[i].empty() || bucket[i].back().first != j)
+                bucket[i].emplace_back(j, 0);
+            bucket[i].back().second++;
+        }
     }
 
+    auto probe = [&bucket](int i, int j) -> int {
+        auto it = std::lower_bound(bucket[i].begin(), bucket[i].end(), std::make_pair(j, 0));
+        if (it != bucket[i].end() && it->first == j)
+            return it->second;
+        return 0;
+    };
+
     int threshold = std::numeric_limits<int>::max();
     int max_score = std::numeric_limits<int>::min(), best_i = 0, best_j = 0;
-    for (int i = 0; i < 2; i++) {
-        for (auto &p : bucket[i]) {
-            int j = p.first;
-            int self = p.second;
-            int prev = probe(i, j - 1);
-            int succ = probe(i, j + 1);
+    for (int i = 0; i < NUM_SEQ; i++) {
+        for (size_t k = 0; k < bucket[i].size(); k++) {
+            auto [j, self] = bucket[i][k];
+            int prev = k > 0 && bucket[i][k - 1].first == j - 1 ? bucket[i][k - 1].second : 0;
+            int succ = k + 1 < bucket[i].size() && bucket[i][k + 1].first == j + 1 ? bucket[i][k + 1].second : 0;
 
             if (self * 2 < prev + succ)
                 continue;
@@ -93,7 +184,7 @@ auto Index::fuzzy_locate(const BioSeq &seq) const -> Location {
     // for (int k = left - 5; k <= right + 5; k++) {
     //     if (k == left)
     //         printf("[");
-    //     printf("%d", bucket[best_i][k]);
+    //     printf("%d", probe(best_i, k));
     //     if (k == right)
     //         printf("]");
     //     if (k != right + 5)
@@ -101,10 +192,38 @@ auto Index::fuzzy_locate(const BioSeq &seq) const -> Location {
     // }
     // printf("}\n");
 
-    Location result;
+    int center = std::clamp(best_j * bucket_size + bucket_size / 2, 1, size());
+    int ref = reference_of(center);
+    auto range = reference_range(ref);
+
     result.reversed = best_i == 0 ? false : true;
-    result.left = std::max(1, left * bucket_size);
-    result.right = std::min(size(), (right + 2) * bucket_size - 1);
+    result.ref = ref;
+    result.left = std::max(range.begin, left * bucket_size) - range.begin + 1;
+    result.right = std::min(range.end - 1, (right + 2) * bucket_size - 1) - range.begin + 1;
+
+    // diagonals of the hits inside the window. a structural variant
+    // within the read splits them into several clusters, so report the
+    // middle of the range they cover, with outliers trimmed.
+    auto &best_hits = hits[best_i];
+    auto first = std::lower_bound(best_hits.begin(), best_hits.end(), std::make_pair(left, INT_MIN));
+    auto last = std::lower_bound(best_hits.begin(), best_hits.end(), std::make_pair(right + 2, INT_MIN));
+
+    std::vector<int> diagonals;
+    for (auto it = first; it != last; it++) {
+        diagonals.push_back(it->second);
+    }
+
+    if (diagonals.empty()) {
+        result.diagonal = (result.left + result.right - n) / 2;
+        result.spread = (result.right - result.left + n) / 2;
+    } else {
+        std::sort(diagonals.begin(), diagonals.end());
+        int k = diagonals.size() * DIAGONAL_TRIM;
+        int lo = diagonals[k] - range.begin + 1;
+        int hi = diagonals[diagonals.size() - 1 - k] - range.begin + 1;
+        result.diagonal = lo + (hi - lo) / 2;
+        result.spread = (hi - lo + 1) / 2;
+    }
 
     return result;
 }
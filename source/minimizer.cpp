@@ -0,0 +1,139 @@
+#include <deque>
+#include <algorithm>
+
+#include "index.hpp"
+#include "packed.hpp"
+#include "minimizer.hpp"
+
+
+namespace {
+
+// invertible mix of the 2k-bit code, so that poly-A and friends do not
+// win every window.
+auto hash64(core::u64 key, core::u64 mask) -> core::u64 {
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+}
+
+namespace core {
+
+template <Sequence TSeq>
+auto minimizers(const TSeq &s, int w, int k) -> std::vector<Minimizer> {
+    std::vector<Minimizer> result;
+    u64 mask = k < 32 ? (u64(1) << (2 * k)) - 1 : ~u64(0);
+
+    u64 code = 0;
+    int valid = 0;
+
+    // candidates of the current window, hashes increasing.
+    std::deque<Minimizer> window;
+
+    for (int i = 1; i <= s.size(); i++) {
+        // CMAP maps ACGT to 1..4 and everything else to 0.
+        int c = CMAP[static_cast<u8>(s[i])] - 1;
+        if (c < 0) {
+            valid = 0;
+            window.clear();
+            continue;
+        }
+
+        code = ((code << 2) | c) & mask;
+        if (++valid < k)
+            continue;
+
+        Minimizer m = {hash64(code, mask), i - k + 1};
+        while (!window.empty() && window.back().hash > m.hash) {
+            window.pop_back();
+        }
+        window.push_back(m);
+
+        while (window.front().pos <= m.pos - w) {
+            window.pop_front();
+        }
+
+        if (valid >= k + w - 1) {
+            auto &front = window.front();
+            if (result.empty() || result.back().pos != front.pos)
+                result.push_back(front);
+        }
+    }
+
+    return result;
+}
+
+template auto minimizers(const BioSeq &, int, int) -> std::vector<Minimizer>;
+template auto minimizers(const RevComp<BioSeq> &, int, int) -> std::vector<Minimizer>;
+template auto minimizers(const PackedView &, int, int) -> std::vector<Minimizer>;
+template auto minimizers(const RevComp<PackedView> &, int, int) -> std::vector<Minimizer>;
+
+MinimizerTable::MinimizerTable(int w, int k, int max_occurrence)
+    : _w(w), _k(k), _max_occurrence(max_occurrence) {}
+
+template <Sequence TSeq>
+void MinimizerTable::append(const TSeq &s) {
+    for (auto [hash, pos] : minimizers(s, _w, _k)) {
+        _entries.emplace_back(hash, _n_appended + pos + _k - 1);
+    }
+
+    _n_appended += s.size();
+}
+
+template <Sequence TSeq>
+void MinimizerTable::append_reference(const TSeq &s) {
+    append(s);
+
+    // the separator of Index::append_reference().
+    _n_appended++;
+}
+
+template void MinimizerTable::append(const BioSeq &);
+template void MinimizerTable::append(const PackedView &);
+template void MinimizerTable::append_reference(const BioSeq &);
+template void MinimizerTable::append_reference(const PackedView &);
+
+void MinimizerTable::build() {
+    std::sort(_entries.begin(), _entries.end());
+
+    _hashes.clear();
+    _offsets.clear();
+    _positions.clear();
+
+    for (size_t i = 0, j; i < _entries.size(); i = j) {
+        j = i;
+        while (j < _entries.size() && _entries[j].first == _entries[i].first) {
+            j++;
+        }
+
+        _hashes.push_back(_entries[i].first);
+        _offsets.push_back(_positions.size());
+        if (j - i <= size_t(_max_occurrence)) {
+            for (size_t p = i; p < j; p++) {
+                _positions.push_back(_entries[p].second);
+            }
+        }
+    }
+
+    _offsets.push_back(_positions.size());
+
+    _entries.clear();
+    _entries.shrink_to_fit();
+}
+
+auto MinimizerTable::find(u64 hash) const -> std::optional<std::span<const int>> {
+    auto it = std::lower_bound(_hashes.begin(), _hashes.end(), hash);
+    if (it == _hashes.end() || *it != hash)
+        return std::nullopt;
+
+    int i = it - _hashes.begin();
+    return std::span<const int>(_positions.data() + _offsets[i], _positions.data() + _offsets[i + 1]);
+}
+
+}
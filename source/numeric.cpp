@@ -48,27 +48,41 @@ concept DoubleIterator = requires (U u) {
     *u = 0.0;
 };
 
+// progressive_convex_hull() one point at a time.
+class ProgressiveHull {
+public:
+    auto push(const Vec2d &p) -> double {
+        _sum += push_into<Upper>(_upper, p);
+        _sum -= push_into<Lower>(_lower, p);
+        _sum += last_edge(_lower);
+        _sum -= last_edge(_upper);
+        return std::abs(_sum);
+    }
+
+private:
+    double _sum = 0.0;
+    std::vector<Vec2d> _upper, _lower;
+};
+
 template <typename T, typename U>
 requires Vec2dIterator<T> && DoubleIterator<U>
 void progressive_convex_hull(T beg, const T &end, U dest) {
-    auto sum = 0.0;
-    std::vector<Vec2d> upper, lower;
-
+    ProgressiveHull hull;
     for (auto it = beg; it != end; it++, dest++) {
-        sum += push_into<Upper>(upper, *it);
-        sum -= push_into<Lower>(lower, *it);
-        sum += last_edge(lower);
-        sum -= last_edge(upper);
-        *dest = std::abs(sum);
+        *dest = hull.push(*it);
     }
 }
 
-void vector_sqrt(std::vector<double> &vs) {
+auto bend(double v) -> double {
     constexpr auto BEND_COEFFICIENT = 0.45;
 
+    // return std::sqrt(v);
+    return std::pow(v, BEND_COEFFICIENT);
+}
+
+void vector_sqrt(std::vector<double> &vs) {
     for (auto &v : vs) {
-        // v = std::sqrt(v);
-        v = std::pow(v, BEND_COEFFICIENT);
+        v = bend(v);
     }
 }
 
@@ -95,6 +109,70 @@ auto french_stick_decompose(const std::vector<Vec2d> &vs, int K) -> Decompositio
     progressive_convex_hull(vs.rbegin(), vs.rend(), suffix.rbegin());
     vector_sqrt(suffix);
 
+    // the least area of K slices covering [beg, n), and the length of the
+    // first of them. only the areas are carried through the recursion, so
+    // that no slices are built for the candidates thrown away.
+    std::function<std::pair<double, int>(int, int)> _decompose_impl;
+    _decompose_impl = [n, &vs, &suffix, &_decompose_impl]
+    (int K, int beg) -> std::pair<double, int> {
+        if (K == 1)
+            return {suffix[beg], n - beg};
+
+        int m = n - beg;
+
+        // the prefix hull is grown along with i, as the loop may stop
+        // before the end.
+        ProgressiveHull hull;
+
+        auto opt_area = std::numeric_limits<double>::max();
+        int opt_length = 0;
+        for (int i = 0; i + K <= m; i++) {
+            auto prefix = bend(hull.push(vs[beg + i]));
+            if (prefix > opt_area)
+                break;
+
+            auto subopt_area = K == 2 ?
+                suffix[beg + i + 1] :
+                _decompose_impl(K - 1, beg + i + 1).first;
+            auto new_area = prefix + subopt_area;
+            if (opt_area > new_area) {
+                opt_area = new_area;
+                opt_length = i + 1;
+            }
+        }
+
+        return {opt_area, opt_length};
+    };
+
+    Decomposition result;
+    for (int beg = 0; K > 0; K--) {
+        auto [area, length] = _decompose_impl(K, beg);
+        if (beg == 0)
+            result.area = area;
+
+        // fewer than K points are left in one slice.
+        if (length == 0) {
+            result.slices.push_back({beg, beg + 1});
+            break;
+        }
+
+        result.slices.push_back({beg, beg + length});
+        beg += length;
+    }
+
+    return result;
+}
+
+auto french_stick_decompose_naive(const std::vector<Vec2d> &vs, int K) -> Decomposition {
+    assert(K > 0);
+
+    int n = vs.size();
+
+    std::vector<double> suffix;
+    suffix.resize(n);
+    progressive_convex_hull(vs.rbegin(), vs.rend(), suffix.rbegin());
+    vector_sqrt(suffix);
+
     std::function<Decomposition(int, int)> _decompose_impl;
     _decompose_impl = [n, &vs, &suffix, &_decompose_impl]
     (int K, int beg) -> Decomposition {
@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "packed.hpp"
+
+
+namespace {
+
+// 2-bit code of ACGT, -1 for everything else.
+constexpr auto CODE = [] {
+    std::array<int, 256> table;
+    table.fill(-1);
+    table['A'] = table['a'] = 0;
+    table['C'] = table['c'] = 1;
+    table['G'] = table['g'] = 2;
+    table['T'] = table['t'] = 3;
+    return table;
+}();
+
+}
+
+namespace core {
+
+PackedSeq::PackedSeq(const std::string &s) : _size(s.size()) {
+    _words.resize((_size + 31) / 32);
+
+    for (int p = 0; p < _size; p++) {
+        int c = CODE[static_cast<u8>(s[p])];
+        if (c < 0) {
+            if (!_n_runs.empty() && _n_runs.back().end == p + 1)
+                _n_runs.back().end++;
+            else
+                _n_runs.push_back({p + 1, p + 2});
+            continue;
+        }
+
+        _words[p >> 5] |= u64(c) << ((p & 31) << 1);
+    }
+}
+
+auto PackedSeq::is_n(int i) const -> bool {
+    auto it = std::upper_bound(
+        _n_runs.begin(), _n_runs.end(), i,
+        [](int i, const Range &r) {
+            return i < r.begin;
+        }
+    );
+
+    return it != _n_runs.begin() && i < (it - 1)->end;
+}
+
+auto PackedSeq::unpack() const -> std::string {
+    std::string s;
+    s.resize(_size);
+    for (int i = 1; i <= _size; i++) {
+        s[i - 1] = (*this)[i];
+    }
+
+    return s;
+}
+
+auto PackedSeq::memory() const -> size_t {
+    return _words.size() * sizeof(u64) + _n_runs.size() * sizeof(Range);
+}
+
+}
@@ -0,0 +1,176 @@
+#include "record.hpp"
+
+
+namespace {
+
+using namespace core;
+
+auto record_size(RecordType type) -> size_t {
+    switch (type) {
+        case RecordType::LOCATE: return sizeof(LocateRecord);
+        case RecordType::DUMP: return sizeof(DumpRecord);
+        default: return 0;
+    }
+}
+
+auto has_magic(const char *data, size_t size) -> bool {
+    return size >= sizeof(RECORD_MAGIC) && memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0;
+}
+
+}
+
+namespace core {
+
+auto is_record_file(const std::string &path) -> bool {
+    FILE *fp = fopen(path.data(), "rb");
+    if (!fp)
+        return false;
+
+    char magic[sizeof(RECORD_MAGIC)];
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return has_magic(magic, n);
+}
+
+auto RecordFile::open(const std::string &path) -> bool {
+    _header = nullptr;
+    if (!_file.open(path))
+        return false;
+
+    const char *data = _file.data();
+    size_t size = _file.size();
+    if (size < sizeof(RecordHeader) || !has_magic(data, size))
+        return false;
+
+    // the records and the name table must lie within the file. counts are
+    // divided rather than multiplied, so that no product can overflow.
+    auto header = reinterpret_cast<const RecordHeader *>(data);
+    if (header->version != RECORD_VERSION ||
+        header->record_size == 0 ||
+        header->record_size != record_size(header->type) ||
+        header->names_offset < sizeof(RecordHeader) ||
+        header->names_offset > size ||
+        header->names_offset % alignof(u32) != 0 ||
+        header->n_records > (header->names_offset - sizeof(RecordHeader)) / header->record_size ||
+        size - header->names_offset < sizeof(u32))
+        return false;
+
+    size_t n_names = *reinterpret_cast<const u32 *>(data + header->names_offset);
+    size_t n_words = (size - header->names_offset) / sizeof(u32) - 1;
+    if (n_names + 1 > n_words)
+        return false;
+
+    // offsets start at 0 and never go back.
+    auto offsets = reinterpret_cast<const u32 *>(data + header->names_offset + sizeof(u32));
+    auto names = reinterpret_cast<const char *>(offsets + n_names + 1);
+    if (offsets[0] != 0 || offsets[n_names] > size_t(data + size - names))
+        return false;
+    for (size_t i = 0; i < n_names; i++) {
+        if (offsets[i] > offsets[i + 1])
+            return false;
+    }
+
+    // so that name() needs no check: every record starts with the ids of
+    // the run and the reference.
+    for (u64 i = 0; i < header->n_records; i++) {
+        u32 ids[2];
+        memcpy(ids, data + sizeof(RecordHeader) + i * header->record_size, sizeof(ids));
+        if (ids[0] >= n_names || ids[1] >= n_names)
+            return false;
+    }
+
+    _header = header;
+    _n_names = n_names;
+    _offsets = offsets;
+    _names = names;
+    return true;
+}
+
+auto RecordFile::names() const -> std::vector<std::string> {
+    std::vector<std::string> result;
+    result.reserve(_n_names);
+    for (u32 id = 0; id < _n_names; id++) {
+        result.emplace_back(name(id));
+    }
+
+    return result;
+}
+
+RecordFileWriter::~RecordFileWriter() {
+    close();
+}
+
+void RecordFileWriter::write_encoded(std::string_view s) {
+    size_t i = s.find('\0');
+    size_t j = s.find('\0', i + 1);
+    auto run = s.substr(0, i);
+    auto ref = s.substr(i + 1, j - i - 1);
+    auto record = s.substr(j + 1);
+
+    // replaces the leading ids.
+    u32 ids[2] = {_intern(run), _intern(ref)};
+    fwrite(ids, sizeof(ids), 1, _fp);
+    fwrite(record.data() + sizeof(ids), record.size() - sizeof(ids), 1, _fp);
+    _n_records++;
+}
+
+auto RecordFileWriter::close() -> bool {
+    if (!_fp)
+        return false;
+
+    // the name table follows the records, 4-byte aligned.
+    long end = ftell(_fp);
+    while (end % alignof(u32) != 0) {
+        fputc(0, _fp);
+        end++;
+    }
+
+    u32 n_names = _offsets.size() - 1;
+    fwrite(&n_names, sizeof(n_names), 1, _fp);
+    fwrite(_offsets.data(), sizeof(u32), _offsets.size(), _fp);
+    fwrite(_names.data(), 1, _names.size(), _fp);
+
+    _header.n_records = _n_records;
+    _header.names_offset = end;
+    fseek(_fp, 0, SEEK_SET);
+    fwrite(&_header, sizeof(_header), 1, _fp);
+
+    bool ok = !ferror(_fp);
+    ok = fclose(_fp) == 0 && ok;
+    _fp = nullptr;
+    return ok;
+}
+
+auto RecordFileWriter::_open(const std::string &path, RecordType type, size_t record_size) -> bool {
+    close();
+
+    _fp = fopen(path.data(), "wb");
+    if (!_fp)
+        return false;
+
+    // the header is written again with the counts on close().
+    _header = {};
+    memcpy(_header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    _header.version = RECORD_VERSION;
+    _header.type = type;
+    _header.record_size = record_size;
+    fwrite(&_header, sizeof(_header), 1, _fp);
+
+    _n_records = 0;
+    _names.clear();
+    _offsets = {0};
+    _ids.clear();
+    return true;
+}
+
+auto RecordFileWriter::_intern(std::string_view name) -> u32 {
+    auto [it, inserted] = _ids.try_emplace(std::string(name), _offsets.size() - 1);
+    if (inserted) {
+        _names.append(name);
+        _offsets.push_back(_names.size());
+    }
+
+    return it->second;
+}
+
+}
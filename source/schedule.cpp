@@ -0,0 +1,27 @@
+#include <cstdio>
+
+#include "schedule.hpp"
+
+
+namespace core {
+
+thread_local double WorkerClock::_idle = 0;
+
+// utilization is the busy time of all workers over workers × wall time.
+// a low figure at the end of a pass means a few workers were left with
+// the long tail.
+void WorkerClock::print(const std::string &label) const {
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+    double total = 0;
+    printf("%s: wall %.3lfs, busy", label.data(), wall);
+    for (double t : _busy) {
+        printf(" %.3lfs", t);
+        total += t;
+    }
+
+    double utilization = wall > 0 && !_busy.empty() ? total / (wall * _busy.size()) : 1;
+    printf(" (%.1lf%%).\n", utilization * 100);
+}
+
+}
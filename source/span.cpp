@@ -1,4 +1,5 @@
 #include <tuple>
+#include <algorithm>
 
 #include "index.hpp"
 #include "numeric.hpp"
@@ -236,10 +237,12 @@ namespace core {
 
 template <
     typename TFactory,
-    bool Debug = false
+    bool Debug = false,
+    Sequence TSeq1,
+    Sequence TSeq2
 >
 static inline auto _partial_span_impl(
-    const BioSeq &s1, const BioSeq &s2,
+    const TSeq1 &s1, const TSeq2 &s2,
     const TFactory &factory,
     int offset = 0,
     bool enable_correlation = true
@@ -253,6 +256,13 @@ static inline auto _partial_span_impl(
 
     int n = s1.size(), m = s2.size();
 
+    // s2 is read once per cell, so it is taken out of its view only once.
+    std::string c2;
+    c2.resize(m + 1);
+    for (int j = 1; j <= m; j++) {
+        c2[j] = s2[j];
+    }
+
     std::vector<Record> f[2];
     for (int i = 0; i < 2; i++) {
         f[i].resize(m + 1);
@@ -265,12 +275,13 @@ static inline auto _partial_span_impl(
     opt.resize(m + 1, Record::max());
 
     for (int i = 1; i <= n; i++) {
+        char c1 = s1[offset + i];
         for (int j = m; j > 0; j--) {
             f[1][j] = f[1][j] + Record{1, 1, 0};
             update(f[1][j], f[0][j] + Record{1 + PENALTY, 1, 0});
 
             f[0][j] = Record::max();
-            if (s1[offset + i] == s2[j]) {
+            if (c1 == c2[j]) {
                 update(f[0][j], f[0][j - 1] + Record{0, 1, 1});
                 update(f[0][j], f[1][j - 1] + Record{0, 1, 1});
             }
@@ -375,7 +386,7 @@ static inline auto _partial_span_impl(
             printf("warn: triggered correlation: offset=%d\n", offset);
 
             if (offset > OFFSET_THRESHOLD)
-                return _partial_span_impl(s1, s2, factory, offset, false);
+                return _partial_span_impl<TFactory, Debug>(s1, s2, factory, offset, false);
         }
 
         corner = 0;
@@ -387,7 +398,8 @@ static inline auto _partial_span_impl(
     return result;
 }
 
-auto prefix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _prefix_span_impl(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
     return _partial_span_impl(
         s1, s2,
         [&](int offset) {
@@ -402,12 +414,23 @@ auto prefix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment {
     );
 }
 
-auto suffix_span(const BioSeq &_s1, const BioSeq &_s2) -> Alignment {
+template <Sequence TSeq>
+static auto _reversed(const TSeq &s) -> std::string {
+    int n = s.size();
+    std::string result;
+    result.resize(n);
+    for (int i = 0; i < n; i++) {
+        result[i] = s[n - i];
+    }
+
+    return result;
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+static auto _suffix_span_impl(const TSeq1 &_s1, const TSeq2 &_s2) -> Alignment {
     int n = _s1.size(), m = _s2.size();
 
-    auto c1 = _s1.clone(), c2 = _s2.clone();
-    std::reverse(c1.begin(), c1.end());
-    std::reverse(c2.begin(), c2.end());
+    auto c1 = _reversed(_s1), c2 = _reversed(_s2);
 
     auto s1 = BioSeq(c1), s2 = BioSeq(c2);
 
@@ -425,4 +448,30 @@ auto suffix_span(const BioSeq &_s1, const BioSeq &_s2) -> Alignment {
     );
 }
 
+auto prefix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+    return _prefix_span_impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+auto prefix_span(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
+    return _prefix_span_impl(s1, s2);
+}
+
+auto suffix_span(const BioSeq &s1, const BioSeq &s2) -> Alignment {
+    return _suffix_span_impl(s1, s2);
+}
+
+template <Sequence TSeq1, Sequence TSeq2>
+auto suffix_span(const TSeq1 &s1, const TSeq2 &s2) -> Alignment {
+    return _suffix_span_impl(s1, s2);
+}
+
+template auto prefix_span(const BioSeq &, const RevComp<BioSeq> &) -> Alignment;
+template auto prefix_span(const PackedView &, const PackedView &) -> Alignment;
+template auto prefix_span(const PackedView &, const RevComp<PackedView> &) -> Alignment;
+
+template auto suffix_span(const BioSeq &, const RevComp<BioSeq> &) -> Alignment;
+template auto suffix_span(const PackedView &, const PackedView &) -> Alignment;
+template auto suffix_span(const PackedView &, const RevComp<PackedView> &) -> Alignment;
+
 }
@@ -0,0 +1,168 @@
+#include <cstdlib>
+
+#include <algorithm>
+
+#include "numeric.hpp"
+#include "stages.hpp"
+#include "writer.hpp"
+
+
+namespace {
+
+// when the span found at an end is shorter than this, or covers all but
+// this much of the run, the end is taken to match the reference.
+constexpr int START_LENGTH_THRESHOLD = 65;
+
+// view of the sequence of `e`, stored the same way as the first argument.
+auto view_like(const core::BioSeq &, core::DictEntry &e) -> core::BioSeq {
+    return core::BioSeq(e.sequence);
+}
+
+auto view_like(const core::PackedView &, core::DictEntry &e) -> core::PackedView {
+    return e.packed.view();
+}
+
+// t is the run in the orientation of the reference.
+template <typename TSeq>
+auto find_breakpoints_impl(
+    core::DictEntry &ref, core::DictEntry &run, const core::Placement &p,
+    const TSeq &t, std::string &log
+) -> core::Breakpoints {
+    auto rate = 1.0 - double(p.loss) / run.sequence.size();
+    auto s = core::BioSeq(ref.sequence, p.left, p.right + 1);
+
+    auto prefix = core::prefix_span(s, t);
+    if (prefix.mark) {
+        s = core::BioSeq(ref.sequence,
+            std::max(1UL, p.right - run.sequence.size() + 1),
+            p.right + 1
+        );
+
+        core::appendf(log, "warn: triggered prefix correlation.\n");
+        prefix = core::prefix_span(s, t);
+    }
+
+    auto suffix = core::suffix_span(s, t);
+    if (suffix.mark) {
+        s = core::BioSeq(ref.sequence,
+            p.left,
+            std::min(ref.sequence.size(), p.left + run.sequence.size())
+        );
+
+        core::appendf(log, "warn: triggered suffix correlation.\n");
+        suffix = core::suffix_span(s, t);
+    }
+
+    bool contained = true;
+    core::Vec2i front, back;
+
+    int left = s.begin() - ref.sequence.begin() + 1;
+
+    if (prefix.range2.length() > START_LENGTH_THRESHOLD &&
+        prefix.range2.length() < run.sequence.size() - START_LENGTH_THRESHOLD) {
+        front = core::Vec2i(
+            /*p.left*/ left + prefix.range1.end - 1,
+            prefix.range2.end - 1
+        );
+    } else
+        contained = false;
+
+    if (suffix.range2.length() > START_LENGTH_THRESHOLD &&
+        suffix.range2.length() < run.sequence.size() - START_LENGTH_THRESHOLD) {
+        back = core::Vec2i(
+            /*p.left*/ left + suffix.range1.begin - 2,
+            suffix.range2.begin
+        );
+    } else
+        contained = false;
+
+    auto inv_match_rate = -1.0;
+    int l1 = front.x, r1 = back.x;
+    int l2 = front.y + 1, r2 = back.y - 1;
+    if (contained && 0 < l1 && l1 <= r1 && 0 < l2 && l2 <= r2) {
+        auto reversed = core::reverse_complement(t.take(l2, r2 + 1));
+
+        int loss = core::full_align(
+            core::BioSeq(ref.sequence, front.x, back.x + 1),
+            reversed
+        );
+
+        inv_match_rate = 1 - 2.0 * loss / (r1 - l1 + 1 + r2 - l2 + 1);
+    }
+
+    core::appendf(log,
+        "%s @%s[%d, %d]: %%=%.3lf, n=%d, m=%d, [%d, %d)-[%d, %d)=%d, [%d, %d)-[%d, %d)=%d\n",
+        run.name.data(),
+        ref.name.data(),
+        p.left, p.right,
+        rate, s.size(), t.size(),
+        prefix.range1.begin, prefix.range1.end,
+        prefix.range2.begin, prefix.range2.end,
+        prefix.loss,
+        suffix.range1.begin, suffix.range1.end,
+        suffix.range2.begin, suffix.range2.end,
+        suffix.loss
+    );
+
+    int dist1 = front.y > 0 ? ((back.y > 0 ? back.y : run.sequence.size()) - front.y) : 0;
+    int dist2 = back.y > 0 ? (back.y - front.y) : 0;
+    return {
+        front.x, front.y, std::abs(dist1),
+        back.x, back.y, std::abs(dist2),
+        inv_match_rate
+    };
+}
+
+}
+
+namespace core {
+
+template <Sequence TSeq>
+auto locate_run(
+    const Index &index, const LocateOptions &options, const RunAlignOptions &align,
+    Dict &refs, int base, const TSeq &t, AlignWorkspace &workspace
+) -> Placement {
+    auto location = index.fuzzy_locate(t, workspace, options);
+    int i = base + location.ref;
+
+    auto s = view_like(t, refs[i]).take(location.left, location.right + 1);
+
+    auto align_to = [&](const auto &q) {
+        if (!align.banded)
+            return local_align(s, q);
+
+        // row i of s against column j of q lies near i - j = diagonal.
+        int diagonal = location.diagonal - location.left + 1;
+        int width = location.spread + MIN_BAND_WIDTH + int(align.band_error * q.size() / 2);
+        return banded_local_align(s, q, diagonal, width);
+    };
+
+    auto result = location.reversed ? align_to(reverse_complement(t)) : align_to(t);
+
+    return {
+        i,
+        result.range1.begin + location.left - 1,
+        result.range1.end - 1 + location.left - 1,
+        result.loss,
+        location.reversed,
+        location.seeds
+    };
+}
+
+template auto locate_run(
+    const Index &, const LocateOptions &, const RunAlignOptions &,
+    Dict &, int, const BioSeq &, AlignWorkspace &
+) -> Placement;
+template auto locate_run(
+    const Index &, const LocateOptions &, const RunAlignOptions &,
+    Dict &, int, const PackedView &, AlignWorkspace &
+) -> Placement;
+
+auto find_breakpoints(DictEntry &ref, DictEntry &run, const Placement &p, std::string &log) -> Breakpoints {
+    auto t = BioSeq(run.sequence);
+    if (p.reversed)
+        return find_breakpoints_impl(ref, run, p, reverse_complement(t), log);
+    return find_breakpoints_impl(ref, run, p, t, log);
+}
+
+}
@@ -0,0 +1,43 @@
+#include "stream.hpp"
+
+
+namespace core {
+
+ReadStream::~ReadStream() {
+    // a reader blocked on a full queue gives up once it is closed.
+    _queue.close();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+auto ReadStream::open(const std::string &path, bool packed) -> bool {
+    // with nothing to read, next() returns nullopt instead of blocking.
+    if (!_reader.open(path)) {
+        _queue.close();
+        return false;
+    }
+
+    _thread = std::thread([this, packed] {
+        for (size_t id = 0; ; id++) {
+            DictEntry e;
+            if (!_reader.next(e, packed) || !_queue.push({id, std::move(e)}))
+                break;
+        }
+
+        _queue.close();
+    });
+
+    return true;
+}
+
+auto ReadStream::next(size_t *id) -> std::optional<DictEntry> {
+    auto item = _queue.pop();
+    if (!item)
+        return std::nullopt;
+
+    if (id)
+        *id = item->first;
+    return std::move(item->second);
+}
+
+}
@@ -15,6 +15,14 @@ bool startswith(const std::string &target, const std::string &pattern) {
     return true;
 }
 
+auto reference_id(int i) -> std::string {
+    return "S" + std::to_string(i);
+}
+
+auto run_prefix(int i) -> std::string {
+    return reference_id(i) + "_";
+}
+
 auto watson_crick_complement(const std::string &s) -> std::string {
     std::string t(s.rbegin(), s.rend());
 
@@ -0,0 +1,158 @@
+#include <cstdarg>
+
+#include "writer.hpp"
+
+
+namespace {
+
+// the output thread collects this many bytes before each fwrite().
+constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+}
+
+namespace core {
+
+void appendf(std::string &buffer, const char *fmt, ...) {
+    va_list args, copy;
+    va_start(args, fmt);
+    va_copy(copy, args);
+
+    int n = vsnprintf(nullptr, 0, fmt, copy);
+    va_end(copy);
+
+    if (n > 0) {
+        size_t size = buffer.size();
+        buffer.resize(size + n + 1);
+        vsnprintf(buffer.data() + size, n + 1, fmt, args);
+        buffer.resize(size + n);
+    }
+
+    va_end(args);
+}
+
+RecordWriter::~RecordWriter() {
+    close();
+}
+
+void RecordWriter::open(FILE *fp, bool ordered) {
+    _start(fp, false, ordered);
+}
+
+auto RecordWriter::open(const std::string &path, bool ordered) -> bool {
+    FILE *fp = fopen(path.data(), "w");
+    if (!fp)
+        return false;
+
+    _start(fp, true, ordered);
+    return true;
+}
+
+void RecordWriter::open(std::function<void(const std::string &)> sink, bool ordered) {
+    _sink = std::move(sink);
+    _start(nullptr, false, ordered);
+}
+
+void RecordWriter::write(u64 id, std::string record) {
+    _queue.push({id, std::move(record)});
+}
+
+void RecordWriter::flush() {
+    if (!_thread.joinable())
+        return;
+
+    std::promise<void> flushed;
+    auto done = flushed.get_future();
+    if (_queue.push({0, {}, &flushed}))
+        done.wait();
+}
+
+auto RecordWriter::close() -> bool {
+    if (_thread.joinable()) {
+        _queue.close();
+        _thread.join();
+    }
+
+    bool ok = !_failed;
+    if (_owned)
+        ok = fclose(_fp) == 0 && ok;
+
+    _fp = nullptr;
+    _sink = nullptr;
+    _owned = false;
+    _failed = false;
+    return ok;
+}
+
+void RecordWriter::_start(FILE *fp, bool owned, bool ordered) {
+    _fp = fp;
+    _owned = owned;
+    _ordered = ordered;
+    _thread = std::thread([this] {
+        _run();
+    });
+}
+
+void RecordWriter::_run() {
+    std::string buffer;
+    auto write_buffer = [&] {
+        if (fwrite(buffer.data(), 1, buffer.size(), _fp) != buffer.size())
+            _failed = true;
+        buffer.clear();
+    };
+
+    auto put = [&](const std::string &record) {
+        if (_sink) {
+            if (!record.empty())
+                _sink(record);
+            return;
+        }
+
+        buffer.append(record);
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE)
+            write_buffer();
+    };
+
+    // records that came in ahead of next_id.
+    std::map<u64, std::string> pending;
+    u64 next_id = 0;
+
+    // missing records leave gaps, which are skipped.
+    auto drain = [&] {
+        for (auto &[id, record] : pending) {
+            put(record);
+        }
+
+        pending.clear();
+        next_id = 0;
+
+        if (_fp) {
+            write_buffer();
+            if (fflush(_fp) != 0)
+                _failed = true;
+        }
+    };
+
+    while (auto item = _queue.pop()) {
+        if (item->flushed) {
+            drain();
+            item->flushed->set_value();
+        } else if (!_ordered)
+            put(item->record);
+        else if (item->id != next_id)
+            pending.emplace(item->id, std::move(item->record));
+        else {
+            put(item->record);
+            next_id++;
+
+            for (auto it = pending.begin(); it != pending.end() && it->first == next_id; ) {
+                put(it->second);
+                next_id++;
+                it = pending.erase(it);
+            }
+        }
+    }
+
+    drain();
+}
+
+}
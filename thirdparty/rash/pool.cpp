@@ -1,12 +1,25 @@
 #include "pool.hpp"
 
 
+namespace {
+
+// the pool and queue of the worker running on this thread, if any.
+thread_local ThreadPool *current_pool = nullptr;
+thread_local int current_id = -1;
+
+}
+
+// fewer than one worker, as from -j0 or a hardware_concurrency() of 0,
+// is taken as one, so that size() is never 0.
 ThreadPool::ThreadPool(int n_workers)
-    : stopped(false) {
+    : stopped(false), n_pending(0), n_sleeping(0), next_queue(0) {
+    n_workers = std::max(1, n_workers);
+    queues.reset(new Queue[n_workers]);
+
     workers.reserve(n_workers);
     for (int i = 0; i < n_workers; i++) {
-        auto t = std::thread([this] {
-            _worker_fn();
+        auto t = std::thread([this, i] {
+            _worker_fn(i);
         });
 
         workers.push_back(std::move(t));
@@ -25,38 +38,80 @@ ThreadPool::~ThreadPool() {
     }
 }
 
-void ThreadPool::_worker_fn() {
-    while (true) {
-        std::unique_lock lock(mutex);
-        cond.wait(lock, [this] {
-            return !tasks.empty() || stopped;
-        });
+void ThreadPool::submit(Task task) {
+    int id = current_pool == this ? current_id : next_queue++ % size();
 
-        if (!tasks.empty()) {
-            auto task = std::move(tasks.front());
-            tasks.pop_front();
-            lock.unlock();
-
-            try {
-                task.fn();
-                task.promise.set_value();
-            } catch (std::exception_ptr e) {
-                task.promise.set_exception(e);
-            }
-        } else
-            break;
+    {
+        std::lock_guard guard(queues[id].mutex);
+        queues[id].tasks.push_back(std::move(task));
+    }
+
+    // pairs with the sleeping worker bumping n_sleeping before it checks
+    // n_pending: one of the two always sees the other.
+    n_pending++;
+    if (n_sleeping > 0) {
+        std::lock_guard guard(mutex);
+        cond.notify_one();
     }
 }
 
-auto ThreadPool::run(const TaskFn &fn) -> std::future<void> {
-    auto task = Task{fn};
-    auto future = task.promise.get_future();
+auto ThreadPool::try_run_one() -> bool {
+    Task task;
+    if (!_take(current_pool == this ? current_id : -1, task))
+        return false;
 
-    std::unique_lock lock(mutex);
-    tasks.push_back(std::move(task));
-    lock.unlock();
+    task();
+    return true;
+}
+
+// the back of the own queue first, then the front of the others'.
+auto ThreadPool::_take(int id, Task &task) -> bool {
+    if (n_pending == 0)
+        return false;
 
-    cond.notify_one();
+    int n = size();
+    for (int k = 0; k < n; k++) {
+        int victim = id >= 0 ? (id + k) % n : k;
+        auto &queue = queues[victim];
 
-    return future;
+        std::lock_guard guard(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        if (victim == id) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        n_pending--;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::_worker_fn(int id) {
+    current_pool = this;
+    current_id = id;
+
+    while (true) {
+        Task task;
+        if (_take(id, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock lock(mutex);
+        n_sleeping++;
+        cond.wait(lock, [this] {
+            return n_pending > 0 || stopped;
+        });
+        n_sleeping--;
+
+        if (stopped && n_pending == 0)
+            break;
+    }
 }
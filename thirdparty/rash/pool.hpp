@@ -1,15 +1,129 @@
 #pragma once
 
-#include <list>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <future>
-#include <functional>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <condition_variable>
 
 
-class ThreadPool {
+// move-only void() callable. captures up to INLINE_SIZE bytes are kept
+// inline, so most tasks need no allocation of their own.
+class Task {
 public:
-    using TaskFn = std::function<void()>;
+    Task() = default;
+
+    template <typename TFn, typename = std::enable_if_t<!std::is_same_v<std::decay_t<TFn>, Task>>>
+    Task(TFn &&fn) {
+        using Fn = std::decay_t<TFn>;
+        if constexpr (fits_inline<Fn>) {
+            new (buffer) Fn(std::forward<TFn>(fn));
+            vtable = &inline_vtable<Fn>;
+        } else {
+            *reinterpret_cast<Fn **>(buffer) = new Fn(std::forward<TFn>(fn));
+            vtable = &heap_vtable<Fn>;
+        }
+    }
+
+    Task(Task &&rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    auto operator=(Task &&rhs) noexcept -> Task & {
+        if (this != &rhs) {
+            reset();
+            if (rhs.vtable) {
+                rhs.vtable->move(buffer, rhs.buffer);
+                vtable = rhs.vtable;
+                rhs.vtable = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    auto operator=(const Task &) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return vtable != nullptr;
+    }
+
+    void operator()() {
+        vtable->invoke(buffer);
+    }
+
+    void reset() {
+        if (vtable)
+            vtable->destroy(buffer);
+        vtable = nullptr;
+    }
+
+private:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    struct VTable {
+        void (*invoke)(void *);
+        void (*move)(void *dst, void *src);
+        void (*destroy)(void *);
+    };
+
+    template <typename Fn>
+    static constexpr bool fits_inline =
+        sizeof(Fn) <= INLINE_SIZE &&
+        alignof(Fn) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<Fn>;
+
+    template <typename Fn>
+    static constexpr VTable inline_vtable = {
+        [](void *p) {
+            (*static_cast<Fn *>(p))();
+        },
+        [](void *dst, void *src) {
+            new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        },
+        [](void *p) {
+            static_cast<Fn *>(p)->~Fn();
+        },
+    };
 
+    template <typename Fn>
+    static constexpr VTable heap_vtable = {
+        [](void *p) {
+            (**static_cast<Fn **>(p))();
+        },
+        [](void *dst, void *src) {
+            *static_cast<Fn **>(dst) = *static_cast<Fn **>(src);
+        },
+        [](void *p) {
+            delete *static_cast<Fn **>(p);
+        },
+    };
+
+    alignas(std::max_align_t) unsigned char buffer[INLINE_SIZE];
+    const VTable *vtable = nullptr;
+};
+
+// work-stealing pool. every worker has its own deque: it pushes and pops
+// its own tasks at the back and steals from the front of the others', so
+// workers only contend when one runs dry. tasks submitted from outside
+// the pool are dealt to the workers round-robin.
+class ThreadPool {
+public:
     ThreadPool() : ThreadPool(std::thread::hardware_concurrency()) {}
     ThreadPool(int n_workers);
     ~ThreadPool();
@@ -19,19 +133,142 @@ public:
     auto operator=(const ThreadPool &) = delete;
     auto operator=(ThreadPool &&) = delete;
 
-    auto run(const TaskFn &fn) -> std::future<void>;
+    auto size() const -> int {
+        return workers.size();
+    }
 
-private:
-    struct Task {
-        TaskFn fn;
+    // fire-and-forget. see TaskGroup for waiting on a batch of tasks.
+    void submit(Task task);
+
+    template <typename TFn>
+    auto run(TFn &&fn) -> std::future<void> {
         std::promise<void> promise;
-    };
+        auto future = promise.get_future();
+        submit([fn = std::forward<TFn>(fn), promise = std::move(promise)]() mutable {
+            try {
+                fn();
+                promise.set_value();
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        });
 
-    void _worker_fn();
+        return future;
+    }
+
+    // runs one pending task on the calling thread, if there is any.
+    auto try_run_one() -> bool;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
 
     std::atomic<bool> stopped;
+    std::atomic<int> n_pending;
+    std::atomic<int> n_sleeping;
+    std::atomic<unsigned> next_queue;
+
     std::mutex mutex;
     std::condition_variable cond;
+    std::unique_ptr<Queue[]> queues;
     std::vector<std::thread> workers;
-    std::list<Task> tasks;
+
+    auto _take(int id, Task &task) -> bool;
+    void _worker_fn(int id);
 };
+
+// tasks that can be waited on together, without a future per task. the
+// first exception thrown by a task is rethrown by wait().
+class TaskGroup {
+public:
+    TaskGroup(ThreadPool &_pool) : pool(_pool) {}
+
+    TaskGroup(const TaskGroup &) = delete;
+    auto operator=(const TaskGroup &) = delete;
+
+    ~TaskGroup() {
+        wait_all();
+    }
+
+    template <typename TFn>
+    void run(TFn &&fn) {
+        {
+            std::lock_guard guard(mutex);
+            n_running++;
+        }
+
+        pool.submit([this, fn = std::forward<TFn>(fn)]() mutable {
+            std::exception_ptr e;
+            try {
+                fn();
+            } catch (...) {
+                e = std::current_exception();
+            }
+
+            std::lock_guard guard(mutex);
+            if (e && !error)
+                error = e;
+            if (--n_running == 0)
+                done.notify_all();
+        });
+    }
+
+    void wait() {
+        wait_all();
+
+        std::lock_guard guard(mutex);
+        if (error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+private:
+    ThreadPool &pool;
+    int n_running = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    // the waiting thread runs pending tasks in the meantime, so waiting
+    // from inside a task does not starve the pool. the timeout covers
+    // tasks submitted after it has found none to run.
+    void wait_all() {
+        while (true) {
+            {
+                std::lock_guard guard(mutex);
+                if (n_running == 0)
+                    return;
+            }
+
+            if (pool.try_run_one())
+                continue;
+
+            std::unique_lock lock(mutex);
+            done.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                return n_running == 0;
+            });
+        }
+    }
+};
+
+// calls fn(i) for every i in [begin, end) on the pool, in chunks of
+// `grain` consecutive indices, and returns when all calls are done. the
+// default grain gives every worker about four chunks.
+template <typename TFn>
+void parallel_for(ThreadPool &pool, int begin, int end, const TFn &fn, int grain = 0) {
+    if (grain <= 0)
+        grain = std::max(1, (end - begin + 4 * pool.size() - 1) / (4 * pool.size()));
+
+    TaskGroup group(pool);
+    for (int i = begin; i < end; i += grain) {
+        int last = std::min(end, i + grain);
+        group.run([&fn, i, last] {
+            for (int j = i; j < last; j++) {
+                fn(j);
+            }
+        });
+    }
+
+    group.wait();
+}